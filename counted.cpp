@@ -1,29 +1,143 @@
 #include "counted.h"
 #include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    size_t hash(counted const* p)
+    {
+        uint64_t h = reinterpret_cast<uintptr_t>(p);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+}
+
+counted::instance_set::~instance_set()
+{
+    std::free(slots);
+}
+
+size_t counted::instance_set::find(counted const* p) const
+{
+    size_t mask = capacity - 1;
+    size_t i = hash(p) & mask;
+    while (slots[i] != nullptr && slots[i] != p)
+        i = (i + 1) & mask;
+    return i;
+}
+
+bool counted::instance_set::insert(counted const* p)
+{
+    if (2 * (count + 1) > capacity)
+        grow();
+
+    size_t i = find(p);
+    if (slots[i] == p)
+        return false;
+
+    slots[i] = p;
+    ++count;
+    return true;
+}
+
+bool counted::instance_set::erase(counted const* p)
+{
+    if (count == 0)
+        return false;
+
+    size_t i = find(p);
+    if (slots[i] == nullptr)
+        return false;
+
+    // Backward shift deletion: pull later entries of the probe sequence into
+    // the hole so lookups never need tombstones.
+    size_t mask = capacity - 1;
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; slots[j] != nullptr; j = (j + 1) & mask)
+    {
+        size_t home = hash(slots[j]) & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask))
+        {
+            slots[hole] = slots[j];
+            hole = j;
+        }
+    }
+    slots[hole] = nullptr;
+
+    --count;
+    return true;
+}
+
+bool counted::instance_set::contains(counted const* p) const
+{
+    return count != 0 && slots[find(p)] == p;
+}
+
+void counted::instance_set::grow()
+{
+    size_t new_capacity = capacity == 0 ? 64 : 2 * capacity;
+    auto new_slots = static_cast<counted const**>(std::calloc(new_capacity, sizeof(counted const*)));
+    if (new_slots == nullptr)
+        throw std::bad_alloc();
+
+    counted const** old_slots = slots;
+    size_t old_capacity = capacity;
+    slots = new_slots;
+    capacity = new_capacity;
+    for (size_t i = 0; i != old_capacity; ++i)
+        if (old_slots[i] != nullptr)
+            slots[find(old_slots[i])] = old_slots[i];
+    std::free(old_slots);
+}
 
 counted::counted(int data)
     : data(data)
 {
-    auto p = instances.insert(this);
-    EXPECT_TRUE(p.second);
+    born(this);
+    if (tracking)
+    {
+        EXPECT_TRUE(instances.insert(this));
+    }
+    else
+    {
+        ++untracked;
+    }
 }
 
 counted::counted(counted const& other)
     : data(other.data)
 {
-    auto p = instances.insert(this);
-    EXPECT_TRUE(p.second);
+    born(this);
+    if (tracking)
+    {
+        EXPECT_TRUE(instances.insert(this));
+    }
+    else
+    {
+        ++untracked;
+    }
 }
 
 counted::~counted()
 {
-    size_t n = instances.erase(this);
-    EXPECT_EQ(1u, n);
+    died(this);
+    if (!instances.erase(this))
+    {
+        EXPECT_NE(0u, untracked);
+        --untracked;
+    }
 }
 
 counted& counted::operator=(counted const& c)
 {
-    EXPECT_TRUE(instances.find(this) != instances.end());
+    if (checking())
+    {
+        EXPECT_TRUE(instances.contains(this));
+    }
 
     data = c.data;
     return *this;
@@ -31,23 +145,64 @@ counted& counted::operator=(counted const& c)
 
 counted::operator int() const
 {
-    EXPECT_TRUE(instances.find(this) != instances.end());
+    if (checking())
+    {
+        EXPECT_TRUE(instances.contains(this));
+    }
 
     return data;
 }
 
-std::set<counted const*> counted::instances;
+bool counted::checking()
+{
+    return tracking && untracked == 0;
+}
+
+void counted::born(counted const* p)
+{
+    size_t h = hash(p);
+    ++current.constructions;
+    current.sum += h;
+    current.xor_sum ^= h;
+}
+
+void counted::died(counted const* p)
+{
+    size_t h = hash(p);
+    ++current.destructions;
+    current.sum -= h;
+    current.xor_sum ^= h;
+}
+
+thread_local counted::instance_set counted::instances;
+thread_local counted::generation counted::current = {};
+thread_local size_t counted::untracked = 0;
+thread_local bool counted::tracking = true;
 
 counted::no_new_instances_guard::no_new_instances_guard()
-    : old_instances(instances)
+    : old(current)
 {}
 
 counted::no_new_instances_guard::~no_new_instances_guard()
 {
-    EXPECT_TRUE(old_instances == instances);
+    expect_no_instances();
 }
 
 void counted::no_new_instances_guard::expect_no_instances()
 {
-    EXPECT_TRUE(old_instances == instances);
+    EXPECT_EQ(current.constructions - old.constructions, current.destructions - old.destructions)
+        << "live counted instances changed";
+    EXPECT_EQ(old.sum, current.sum);
+    EXPECT_EQ(old.xor_sum, current.xor_sum);
+}
+
+counted::counting_mode::counting_mode()
+    : old_tracking(tracking)
+{
+    tracking = false;
+}
+
+counted::counting_mode::~counting_mode()
+{
+    tracking = old_tracking;
 }
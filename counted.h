@@ -1,10 +1,11 @@
 #pragma once
 
-#include <set>
+#include <cstddef>
 
 struct counted
 {
     struct no_new_instances_guard;
+    struct counting_mode;
 
     counted() = delete;
     counted(int data);
@@ -15,9 +16,49 @@ struct counted
     operator int() const;
 
 private:
+    // Open-addressing set of live instances with linear probing. Its storage
+    // comes from malloc, so bookkeeping never goes through the global
+    // operator new and is invisible to fault injection and allocation probes.
+    struct instance_set
+    {
+        ~instance_set();
+
+        bool insert(counted const* p);
+        bool erase(counted const* p);
+        bool contains(counted const* p) const;
+
+    private:
+        size_t find(counted const* p) const;
+        void grow();
+
+        counted const** slots = nullptr;
+        size_t capacity = 0;
+        size_t count = 0;
+    };
+
+    // Running totals over every instance, tracked or not. Together with the
+    // sum and xor of live address hashes they let a guard tell whether the
+    // set of live instances changed without looking at the instances.
+    struct generation
+    {
+        size_t constructions;
+        size_t destructions;
+        size_t sum;
+        size_t xor_sum;
+    };
+
+    static bool checking();
+    static void born(counted const* p);
+    static void died(counted const* p);
+
     int data;
 
-    static std::set<counted const*> instances;
+    // Bookkeeping is per thread, so an instance must die on the thread that
+    // created it.
+    static thread_local instance_set instances;
+    static thread_local generation current;
+    static thread_local size_t untracked;
+    static thread_local bool tracking;
 };
 
 struct counted::no_new_instances_guard
@@ -32,5 +73,21 @@ struct counted::no_new_instances_guard
     void expect_no_instances();
 
 private:
-    std::set<counted const*> old_instances;
+    generation old;
+};
+
+// While alive, new instances are only counted, not registered. Accesses are
+// not checked until every such instance is destroyed, since they cannot be
+// told apart from dangling ones. Meant for throughput runs over large lists.
+struct counted::counting_mode
+{
+    counting_mode();
+
+    counting_mode(counting_mode const&) = delete;
+    counting_mode& operator=(counting_mode const&) = delete;
+
+    ~counting_mode();
+
+private:
+    bool old_tracking;
 };
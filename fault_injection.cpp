@@ -1,46 +1,163 @@
 #include "fault_injection.h"
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <exception>
 #include <iostream>
+#include <random>
+#include <thread>
 #include <vector>
 
 #include <sys/mman.h>
 
 namespace
 {
+    // Array in a virtual range reserved once up front. Pages are committed by
+    // the kernel when first touched, so the array grows in place: no copies and
+    // no system calls after construction.
     template <typename T>
-    struct mmap_allocator
+    struct mmap_vector
     {
-        using value_type = T;
+        static constexpr size_t reserved_bytes = size_t(64) << 20;
+        static constexpr size_t capacity = reserved_bytes / sizeof(T);
 
-        mmap_allocator() = default;
-        
-        T* allocate(size_t n)
+        mmap_vector()
         {
-            void* ptr = mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+            void* ptr = mmap(nullptr, reserved_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
             if (ptr == MAP_FAILED)
                 throw std::bad_alloc();
-            return reinterpret_cast<T*>(ptr);
+            data = static_cast<T*>(ptr);
         }
-        
-        void deallocate(void* p, std::size_t n)
+
+        mmap_vector(mmap_vector const&) = delete;
+        mmap_vector& operator=(mmap_vector const&) = delete;
+
+        ~mmap_vector()
         {
-            int r = munmap(p, n);
+            int r = munmap(data, reserved_bytes);
             if (r != 0)
                 std::abort();
         }
-        
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        bool empty() const
+        {
+            return count == 0;
+        }
+
+        T& operator[](size_t i)
+        {
+            return data[i];
+        }
+
+        T const& operator[](size_t i) const
+        {
+            return data[i];
+        }
+
+        T& back()
+        {
+            return data[count - 1];
+        }
+
+        T const* begin() const
+        {
+            return data;
+        }
+
+        T const* end() const
+        {
+            return data + count;
+        }
+
+        void push_back(T const& value)
+        {
+            if (count == capacity)
+                std::abort();
+            data[count++] = value;
+        }
+
+        void resize(size_t n)
+        {
+            if (n > capacity)
+                std::abort();
+            for (size_t i = count; i < n; ++i)
+                data[i] = T();
+            count = n;
+        }
+
+    private:
+        T* data;
+        size_t count = 0;
+    };
+
+    struct fault_sampler
+    {
+        std::mt19937_64 random;
+        std::bernoulli_distribution fires;
     };
 
     struct fault_injection_context
     {
-        std::vector<size_t, mmap_allocator<size_t> > skip_ranges;
+        mmap_vector<size_t> skip_ranges;
         size_t error_index = 0;
         size_t skip_index = 0;
         bool fault_registred = false;
+        // Whether a new fault is injected once skip_ranges is used up.
+        bool extend = true;
+        // If set, faults are drawn at random and appended to skip_ranges.
+        fault_sampler* sampler = nullptr;
+    };
+
+    struct schedule_failure
+    {
+        std::vector<size_t> schedule;
+        std::exception_ptr error;
     };
 
     thread_local bool disabled = false;
     thread_local fault_injection_context* context = nullptr;
+    thread_local allocation_stats stats = {};
+
+    // Every block carries its requested size in front so that unsized delete can
+    // keep live_bytes exact.
+    constexpr size_t header_size = alignof(std::max_align_t);
+
+    void* allocate(std::size_t count)
+    {
+        if (should_inject_fault())
+            throw std::bad_alloc();
+
+        void* ptr = malloc(header_size + count);
+        if (!ptr)
+            throw std::bad_alloc();
+
+        *static_cast<std::size_t*>(ptr) = count;
+
+        ++stats.allocations;
+        stats.bytes += count;
+        stats.live_bytes += count;
+        if (stats.live_bytes > stats.peak_bytes)
+            stats.peak_bytes = stats.live_bytes;
+        ++stats.histogram[allocation_size_class(count)];
+
+        return static_cast<char*>(ptr) + header_size;
+    }
+
+    void deallocate(void* ptr) noexcept
+    {
+        if (!ptr)
+            return;
+
+        void* block = static_cast<char*>(ptr) - header_size;
+        ++stats.deallocations;
+        stats.live_bytes -= *static_cast<std::size_t*>(block);
+        free(block);
+    }
 
     void dump_state()
     {
@@ -65,9 +182,26 @@ bool should_inject_fault()
     if (disabled)
         return false;
 
+    if (context->sampler)
+    {
+        if (!context->sampler->fires(context->sampler->random))
+        {
+            ++context->skip_index;
+            return false;
+        }
+        context->skip_ranges.push_back(context->skip_index);
+        ++context->error_index;
+        context->skip_index = 0;
+        context->fault_registred = true;
+        return true;
+    }
+
     assert(context->error_index <= context->skip_ranges.size());
     if (context->error_index == context->skip_ranges.size())
     {
+        if (!context->extend)
+            return false;
+
         ++context->error_index;
         context->skip_ranges.push_back(0);
         context->fault_registred = true;
@@ -94,13 +228,21 @@ void fault_injection_point()
         throw injected_fault("injected fault");
 }
 
-void faulty_run(std::function<void ()> const& f)
+namespace
 {
-    assert(!context);
-    fault_injection_context ctx;
-    context = &ctx;
-    for (;;)
+    enum class run_result
+    {
+        completed,
+        faulted,
+        failed,
+    };
+
+    // Runs f once under ctx. A run fails if f throws without a fault having been
+    // injected, or completes although one was.
+    run_result run_once(fault_injection_context& ctx, std::function<void ()> const& f, std::exception_ptr& error)
     {
+        assert(!context);
+        context = &ctx;
         try
         {
             f();
@@ -109,18 +251,215 @@ void faulty_run(std::function<void ()> const& f)
         {
             fault_injection_disable dg;
             dump_state();
+            context = nullptr;
+            if (ctx.fault_registred)
+                return run_result::faulted;
+            error = std::current_exception();
+            return run_result::failed;
+        }
+        context = nullptr;
+        if (ctx.fault_registred)
+        {
+            error = std::make_exception_ptr(std::logic_error("injected fault was swallowed"));
+            return run_result::failed;
+        }
+        return run_result::completed;
+    }
+
+    // Runs f under every schedule whose first fault skips first, first + stride,
+    // first + 2 * stride, ... allocation points, in the order faulty_run visits
+    // them. Stops at the first failing run.
+    void explore(std::function<void ()> const& f, size_t first, size_t stride, std::vector<schedule_failure>& failures)
+    {
+        fault_injection_context ctx;
+        ctx.skip_ranges.push_back(first);
+        for (;;)
+        {
+            std::exception_ptr error;
+            run_result r = run_once(ctx, f, error);
+            if (r == run_result::completed)
+                break;
+
+            fault_injection_disable dg;
+            if (r == run_result::failed)
+            {
+                failures.push_back({std::vector<size_t>(ctx.skip_ranges.begin(), ctx.skip_ranges.end()), error});
+                break;
+            }
             ctx.skip_ranges.resize(ctx.error_index);
-            ++ctx.skip_ranges.back();
+            ctx.skip_ranges.back() += ctx.skip_ranges.size() == 1 ? stride : 1;
             ctx.error_index = 0;
             ctx.skip_index = 0;
-            assert(ctx.fault_registred);
             ctx.fault_registred = false;
-            continue;
         }
-        assert(!ctx.fault_registred);
-        break;
     }
-    context = nullptr;
+
+    // Prints a schedule as the indices of the allocation points that fail,
+    // which is what replay_faulty_run takes.
+    template <typename Schedule>
+    void print_fault_points(std::ostream& out, Schedule const& skip_ranges)
+    {
+        out << '{';
+        size_t point = 0;
+        for (size_t i = 0; i != skip_ranges.size(); ++i)
+        {
+            point += skip_ranges[i];
+            out << (i == 0 ? "" : ", ") << point;
+            ++point;
+        }
+        out << '}';
+    }
+
+    // Schedules compare in the order faulty_run visits them, so the smallest
+    // failure is the one a serial run would stop at, however the work was split.
+    void report(std::vector<schedule_failure>& failures)
+    {
+        if (failures.empty())
+            return;
+
+        auto first = std::min_element(failures.begin(), failures.end(), [](schedule_failure const& a, schedule_failure const& b) {
+            return a.schedule < b.schedule;
+        });
+        std::cerr << "faulty_run failed with faults at points ";
+        print_fault_points(std::cerr, first->schedule);
+        std::cerr << '\n';
+        std::rethrow_exception(first->error);
+    }
+}
+
+void faulty_run(std::function<void ()> const& f)
+{
+    std::vector<schedule_failure> failures;
+    explore(f, 0, 1, failures);
+    report(failures);
+}
+
+void parallel_faulty_run(std::function<void ()> const& f, size_t threads)
+{
+    assert(!context);
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::vector<schedule_failure>> failures(threads);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    try
+    {
+        for (size_t i = 0; i != threads; ++i)
+            workers.emplace_back([&f, &failures, i, threads] {
+                explore(f, i, threads, failures[i]);
+            });
+    }
+    catch (...)
+    {
+        for (std::thread& w : workers)
+            w.join();
+        throw;
+    }
+    for (std::thread& w : workers)
+        w.join();
+
+    std::vector<schedule_failure> all;
+    for (std::vector<schedule_failure>& w : failures)
+        all.insert(all.end(), w.begin(), w.end());
+    report(all);
+}
+
+void sampled_faulty_run(std::function<void ()> const& f, double probability, uint64_t seed, fault_budget budget)
+{
+    fault_sampler sampler{std::mt19937_64(seed), std::bernoulli_distribution(probability)};
+    auto start = std::chrono::steady_clock::now();
+    fault_injection_context ctx;
+    ctx.sampler = &sampler;
+    for (size_t run = 0; run != budget.runs && std::chrono::steady_clock::now() - start < budget.time; ++run)
+    {
+        ctx.skip_ranges.resize(0);
+        ctx.error_index = 0;
+        ctx.skip_index = 0;
+        ctx.fault_registred = false;
+        std::exception_ptr error;
+        if (run_once(ctx, f, error) == run_result::failed)
+        {
+            fault_injection_disable dg;
+            std::cerr << "sampled_faulty_run with seed " << seed << " failed in run " << run << " with faults at points ";
+            print_fault_points(std::cerr, ctx.skip_ranges);
+            std::cerr << '\n';
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void replay_faulty_run(std::function<void ()> const& f, std::initializer_list<size_t> schedule)
+{
+    fault_injection_context ctx;
+    ctx.extend = false;
+    size_t next = 0;
+    for (size_t point : schedule)
+    {
+        if (point < next)
+            throw std::invalid_argument("replay_faulty_run: fault points must be strictly increasing");
+        ctx.skip_ranges.push_back(point - next);
+        next = point + 1;
+    }
+
+    std::exception_ptr error;
+    if (run_once(ctx, f, error) == run_result::failed)
+        std::rethrow_exception(error);
+}
+
+allocation_stats const& current_allocation_stats()
+{
+    return stats;
+}
+
+size_t allocation_size_class(size_t size)
+{
+    size_t cls = 0;
+    while (cls + 1 < allocation_stats::size_classes && (size_t(1) << cls) < size)
+        ++cls;
+    return cls;
+}
+
+allocation_probe::allocation_probe()
+    : start(stats)
+{
+    stats.peak_bytes = stats.live_bytes;
+}
+
+allocation_probe::~allocation_probe()
+{
+    if (start.peak_bytes > stats.peak_bytes)
+        stats.peak_bytes = start.peak_bytes;
+}
+
+size_t allocation_probe::allocations() const
+{
+    return stats.allocations - start.allocations;
+}
+
+size_t allocation_probe::deallocations() const
+{
+    return stats.deallocations - start.deallocations;
+}
+
+size_t allocation_probe::bytes() const
+{
+    return stats.bytes - start.bytes;
+}
+
+std::ptrdiff_t allocation_probe::live_bytes() const
+{
+    return stats.live_bytes - start.live_bytes;
+}
+
+std::ptrdiff_t allocation_probe::peak_bytes() const
+{
+    return stats.peak_bytes - start.live_bytes;
+}
+
+size_t allocation_probe::histogram(size_t size_class) const
+{
+    return stats.histogram[size_class] - start.histogram[size_class];
 }
 
 fault_injection_disable::fault_injection_disable()
@@ -136,44 +475,30 @@ fault_injection_disable::~fault_injection_disable()
 
 void* operator new(std::size_t count)
 {
-    if (should_inject_fault())
-        throw std::bad_alloc();
-
-    void* ptr = malloc(count);
-    if (!ptr)
-        throw std::bad_alloc();
-
-    return ptr;
+    return allocate(count);
 }
 
 void* operator new[](std::size_t count)
 {
-    if (should_inject_fault())
-        throw std::bad_alloc();
-
-    void* ptr = malloc(count);
-    if (!ptr)
-        throw std::bad_alloc();
-
-    return ptr;
+    return allocate(count);
 }
 
 void operator delete(void* ptr) noexcept
 {
-    free(ptr);
+    deallocate(ptr);
 }
 
 void operator delete[](void* ptr) noexcept
 {
-    free(ptr);
+    deallocate(ptr);
 }
 
 void operator delete(void* ptr, std::size_t) noexcept
 {
-    free(ptr);
+    deallocate(ptr);
 }
 
 void operator delete[](void* ptr, std::size_t) noexcept
 {
-    free(ptr);
+    deallocate(ptr);
 }
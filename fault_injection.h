@@ -1,6 +1,11 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <initializer_list>
+#include <limits>
 #include <stdexcept>
 
 struct injected_fault : std::runtime_error
@@ -12,6 +17,42 @@ bool should_inject_fault();
 void fault_injection_point();
 void faulty_run(std::function<void ()> const& f);
 
+// Same schedules as faulty_run, split between threads by the position of the
+// first fault (0 means one per hardware thread). Every worker has its own
+// fault injection context and counted registry, so f must not share mutable
+// state between calls. Of all failing schedules the one faulty_run would stop
+// at is reported, and its exception rethrown on the calling thread.
+void parallel_faulty_run(std::function<void ()> const& f, size_t threads = 0);
+
+// Limit on the number of runs or on the wall time spent, whichever comes first.
+struct fault_budget
+{
+    fault_budget(size_t runs)
+        : runs(runs)
+        , time(std::chrono::steady_clock::duration::max())
+    {}
+
+    template <typename Rep, typename Period>
+    fault_budget(std::chrono::duration<Rep, Period> time)
+        : runs(std::numeric_limits<size_t>::max())
+        , time(std::chrono::duration_cast<std::chrono::steady_clock::duration>(time))
+    {}
+
+    size_t runs;
+    std::chrono::steady_clock::duration time;
+};
+
+// Runs f until the budget is spent, failing every allocation point with the
+// given probability. A failing run prints the seed and the indices of the
+// points that faulted, then its exception is rethrown. Pass those indices to
+// replay_faulty_run to reproduce it.
+void sampled_faulty_run(std::function<void ()> const& f, double probability, uint64_t seed, fault_budget budget);
+
+// Runs f once, failing exactly the allocation points whose indices (counted from
+// 0 in execution order, strictly increasing) are listed in schedule. Throws
+// std::invalid_argument, without running f, if they are not strictly increasing.
+void replay_faulty_run(std::function<void ()> const& f, std::initializer_list<size_t> schedule);
+
 struct fault_injection_disable
 {
     fault_injection_disable();
@@ -22,3 +63,41 @@ struct fault_injection_disable
 private:
     bool was_disabled;
 };
+
+// Per-thread counters kept by the global operator new/delete. Size class i counts
+// requests of at most 2^i bytes (and more than 2^(i-1)); the last class takes
+// everything larger.
+struct allocation_stats
+{
+    static constexpr size_t size_classes = 16;
+
+    size_t allocations;
+    size_t deallocations;
+    size_t bytes;
+    std::ptrdiff_t live_bytes;
+    std::ptrdiff_t peak_bytes;
+    size_t histogram[size_classes];
+};
+
+allocation_stats const& current_allocation_stats();
+size_t allocation_size_class(size_t size);
+
+// Reports what the current thread allocated since the probe was created. The peak
+// is measured relative to the live bytes at creation.
+struct allocation_probe
+{
+    allocation_probe();
+    allocation_probe(allocation_probe const&) = delete;
+    allocation_probe& operator=(allocation_probe const&) = delete;
+    ~allocation_probe();
+
+    size_t allocations() const;
+    size_t deallocations() const;
+    size_t bytes() const;
+    std::ptrdiff_t live_bytes() const;
+    std::ptrdiff_t peak_bytes() const;
+    size_t histogram(size_t size_class) const;
+
+private:
+    allocation_stats start;
+};
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#include "list_hook.h"
+
+// List threaded through a hook embedded in the elements themselves. The list
+// never allocates, copies or destroys elements: push, insert, erase and splice
+// only relink hooks, and the caller owns the objects.
+//
+// Inserting an element whose hook is already linked is a bug and asserts. With
+// auto_unlink_hook an element silently leaves its list when destroyed, which is
+// why size() walks the list instead of caching a count.
+template <typename T, typename Hook, Hook T::*Member>
+struct basic_intrusive_list {
+
+private:
+
+    using node = list_hook;
+
+    static T* owner(node* n) noexcept {
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(static_cast<Hook*>(n)) - hook_offset());
+    }
+
+    static node* hook(T& value) noexcept {
+        return &(value.*Member);
+    }
+
+    // Measured once, on storage typed and aligned as a T that is never constructed.
+    static std::ptrdiff_t hook_offset() noexcept {
+        static std::ptrdiff_t const offset = [] {
+            union probe {
+                char none;
+                T value;
+
+                probe() noexcept : none() {}
+                ~probe() {}
+            } p;
+            return reinterpret_cast<char const*>(&(p.value.*Member)) - reinterpret_cast<char const*>(&p.value);
+        }();
+        return offset;
+    }
+
+    template <typename V>
+    struct myiterator : std::iterator<std::bidirectional_iterator_tag, V> {
+        friend struct basic_intrusive_list;
+    public:
+        node* cur;
+
+        myiterator() = default;
+        myiterator(myiterator const& other) : cur(other.cur) {};
+        myiterator& operator++() {
+            cur = cur->right;
+            return *this;
+        }
+
+        operator myiterator<V const>() const noexcept {
+            return myiterator<V const>(cur);
+        }
+
+        const myiterator operator++(int) {
+            myiterator<V> copy(*this);
+            ++*this;
+            return copy;
+        }
+
+        myiterator& operator--() {
+            cur = cur->left;
+            return *this;
+        }
+
+        const myiterator operator--(int) {
+            myiterator<V> copy(*this);
+            --*this;
+            return copy;
+        }
+        V& operator*() const { return *owner(cur); }
+
+        V* operator->() const { return owner(cur); }
+
+        template <typename U>
+        bool operator==(myiterator<U> const& other) const {
+            return cur == other.cur;
+        }
+        template <typename U>
+        bool operator!=(myiterator<U> const& other) const {
+            return cur != other.cur;
+        }
+
+    private:
+        explicit myiterator(node* n) : cur(n) {};
+    };
+
+    node fake;
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using iterator = myiterator<T>;
+    using const_iterator = myiterator<T const>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    basic_intrusive_list() = default;
+    basic_intrusive_list(basic_intrusive_list const&) = delete;
+    basic_intrusive_list(basic_intrusive_list&& other) noexcept {
+        swap(other);
+    }
+    basic_intrusive_list& operator=(basic_intrusive_list const&) = delete;
+    basic_intrusive_list& operator=(basic_intrusive_list&& other) noexcept {
+        clear();
+        swap(other);
+        return *this;
+    }
+    ~basic_intrusive_list() {
+        clear();
+    }
+
+    void clear() noexcept;
+    bool empty() const noexcept {
+        return fake.right == &fake;
+    }
+    size_type size() const noexcept {
+        return std::distance(begin(), end());
+    }
+
+    void push_back(T& value) {
+        insert(end(), value);
+    }
+    void pop_back() {
+        if (!empty()) {
+            fake.left->unlink();
+        }
+    }
+    T& back() {
+        return *owner(fake.left);
+    }
+    T const& back() const {
+        return *owner(fake.left);
+    }
+
+    void push_front(T& value) {
+        insert(begin(), value);
+    }
+    void pop_front() {
+        if (!empty()) {
+            fake.right->unlink();
+        }
+    }
+    T& front() {
+        return *owner(fake.right);
+    }
+    T const& front() const {
+        return *owner(fake.right);
+    }
+
+    iterator begin() {
+        return iterator(fake.right);
+    }
+    const_iterator begin() const {
+        return const_iterator(fake.right);
+    }
+
+    iterator end() {
+        return iterator(&fake);
+    }
+    const_iterator end() const {
+        return const_iterator(const_cast<node*>(&fake));
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+    iterator iterator_to(T& value) noexcept {
+        return iterator(hook(value));
+    }
+
+    iterator insert(const_iterator pos, T& value) {
+        node* n = hook(value);
+        assert(!n->is_linked() && "element is already on a list");
+        n->left = pos.cur->left;
+        n->right = pos.cur;
+        pos.cur->left = n;
+        n->left->right = n;
+        return iterator(n);
+    }
+    iterator erase(const_iterator pos) noexcept {
+        node* n = pos.cur;
+        iterator ans(n->right);
+        n->unlink();
+        return ans;
+    }
+    void remove(T& value) noexcept {
+        assert(hook(value)->is_linked());
+        hook(value)->unlink();
+    }
+
+    void splice(const_iterator pos, basic_intrusive_list& other, const_iterator first, const_iterator last) noexcept;
+    void splice(const_iterator pos, basic_intrusive_list& other) noexcept {
+        splice(pos, other, other.begin(), other.end());
+    }
+
+    void swap(basic_intrusive_list& other) noexcept;
+
+    friend void swap(basic_intrusive_list& a, basic_intrusive_list& b) {
+        a.swap(b);
+    }
+};
+
+template <typename T, list_hook T::*Member>
+using intrusive_list = basic_intrusive_list<T, list_hook, Member>;
+
+template <typename T, auto_unlink_hook T::*Member>
+using auto_unlink_list = basic_intrusive_list<T, auto_unlink_hook, Member>;
+
+template <typename T, typename Hook, Hook T::*Member>
+void basic_intrusive_list<T, Hook, Member>::clear() noexcept {
+    node* cur = fake.right;
+    while (cur != &fake) {
+        node* n = cur;
+        cur = cur->right;
+        n->left = n->right = n;
+    }
+    fake.right = fake.left = &fake;
+}
+
+template <typename T, typename Hook, Hook T::*Member>
+void basic_intrusive_list<T, Hook, Member>::swap(basic_intrusive_list &other) noexcept {
+    node* a_l = fake.left;
+    node* a_r = fake.right;
+    node* b_l = other.fake.left;
+    node* b_r = other.fake.right;
+    a_l->right = &other.fake;
+    a_r->left = &other.fake;
+    b_l->right = &fake;
+    b_r->left = &fake;
+    std::swap(fake.left, other.fake.left);
+    std::swap(fake.right, other.fake.right);
+}
+
+template <typename T, typename Hook, Hook T::*Member>
+void basic_intrusive_list<T, Hook, Member>::splice(const_iterator pos, basic_intrusive_list &other, const_iterator first, const_iterator last) noexcept {
+    node* l = first.cur->left;
+
+    pos.cur->left->right = first.cur;
+    first.cur->left = pos.cur->left;
+
+    last.cur->left->right = pos.cur;
+    pos.cur->left = last.cur->left;
+
+    last.cur->left = l;
+    l->right = last.cur;
+}
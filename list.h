@@ -1,23 +1,70 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
 #include <iterator>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
-template <typename T>
+#include "list_hook.h"
+
+struct reaper;
+
+template <typename T, typename Alloc = std::allocator<T>>
+struct list;
+
+// Defined in list_reaper.h.
+template <typename T, typename Alloc>
+void clear_deferred(list<T, Alloc>& c, reaper& r);
+
+template <typename T, typename Alloc>
 struct list {
 
 private:
 
-    struct node {
-        node *left;
-        node *right;
+    using node = list_hook;
+
+    // Node storage allocated in one piece for several nodes. The header takes
+    // the first node of the block and counts the nodes not returned yet; the
+    // block is freed with the last of them, whichever list it ends up in.
+    struct block_header {
+        std::atomic<size_t> live;
+        size_t nodes;
+
+        explicit block_header(size_t nodes) noexcept : live(nodes - 1), nodes(nodes) {}
+    };
+
+    // Node storage without an element, as kept in the spare cache and in chains
+    // from take_storage. Every node remembers the block its storage belongs to,
+    // null for storage allocated on its own.
+    struct stored : node {
+        block_header* block;
 
-        node(node *left, node *right) : left(left), right(right) {};
-        node() : left(this), right(this) {};
+        stored(node *left, node *right, block_header* block) noexcept : node(left, right), block(block) {}
     };
 
-    struct fullnode : node {
+    struct fullnode : stored {
         T val;
-        fullnode(T const& value, node *left, node *right) : node(left, right), val(value) {};
+        template <typename... Args>
+        fullnode(node *left, node *right, block_header* block, Args&&... args)
+            : stored(left, right, block), val(std::forward<Args>(args)...) {}
+    };
+
+    using node_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<fullnode>;
+    using node_traits = std::allocator_traits<node_allocator>;
+
+    static_assert(std::is_same<typename node_traits::pointer, fullnode*>::value, "fancy pointers are not supported");
+
+    // The allocator is an empty base of the sentinel, so it takes no space when stateless.
+    struct sentinel : node, node_allocator {
+        sentinel() = default;
+        explicit sentinel(node_allocator const& alloc) : node(), node_allocator(alloc) {};
+        sentinel(sentinel const&) = delete;
     };
 
     template <typename V>
@@ -70,28 +117,185 @@ private:
         explicit myiterator(node* n) : cur(n) {};
     };
 
-    node fake;
+    // Storage of destroyed nodes kept for reuse, singly linked through right.
+    // Created on first use in the storage of one more node, so it comes from
+    // the same allocator (and pool) as the nodes and lists that never cache pay
+    // one pointer.
+    struct spare_store {
+        node* head = nullptr;
+        size_t count = 0;
+        size_t limit = 0;
+    };
+
+    static_assert(alignof(spare_store) <= alignof(fullnode) && sizeof(spare_store) <= sizeof(fullnode)
+                  && sizeof(block_header) <= sizeof(fullnode),
+                  "bookkeeping must fit in node storage");
+
+    sentinel fake;
+    size_t count = 0;
+    spare_store* spare = nullptr;
+
+    node_allocator& node_alloc() noexcept { return fake; }
+    node_allocator const& node_alloc() const noexcept { return fake; }
+
+    template <typename... Args>
+    fullnode* create_node(node* left, node* right, Args&&... args);
+    void destroy_node(node* n) noexcept;
+    stored* acquire_storage();
+    void release_storage(fullnode* p, block_header* block) noexcept;
+    static void return_storage(node_allocator& alloc, fullnode* p, block_header* block) noexcept;
+    stored* new_block(size_t n);
+    stored* new_storage(size_t n) {
+        return new_storage(n, bulk_storage());
+    }
+    stored* new_storage(size_t n, std::true_type) {
+        return new_block(n);
+    }
+    stored* new_storage(size_t n, std::false_type);
+    spare_store& spare_storage();
+    void release_spare() noexcept;
+    void trim_spare(size_t keep) noexcept;
+    void swap_nodes(list& other) noexcept;
+    void adopt_chain(node* head) noexcept;
+    void destroy_chain(node* head) noexcept;
+    static void reap_chain(void* head, size_t n);
+    node* unlink(node* n, node**& tail) noexcept;
+
+    // Nodes linked both ways but not yet part of any list; tail->right is null.
+    struct chain {
+        node* head = nullptr;
+        node* tail = nullptr;
+        size_t n = 0;
+    };
+
+    node* take_storage(size_t n);
+    void release_storage_chain(node* head) noexcept;
+    template <typename Construct>
+    chain make_chain(node* storage, Construct construct);
+    template <typename Construct>
+    chain make_chain(size_t n, Construct construct) {
+        return make_chain(take_storage(n), construct);
+    }
+    template <typename InputIt>
+    chain make_chain(InputIt first, InputIt last, std::input_iterator_tag);
+    template <typename ForwardIt>
+    chain make_chain(ForwardIt first, ForwardIt last, std::forward_iterator_tag);
+    template <typename InputIt>
+    chain make_chain(InputIt first, InputIt last) {
+        return make_chain(first, last, typename std::iterator_traits<InputIt>::iterator_category());
+    }
+    chain make_chain(size_t n, T const& value);
+    myiterator<T> insert_chain(node* pos, chain c) noexcept;
+
+    template <typename InputIt>
+    using enable_if_iterator = typename std::enable_if<!std::is_integral<InputIt>::value>::type;
+
+    // Allocators that can take back everything they handed out at once, like
+    // pool_allocator.
+    template <typename A, typename = void>
+    struct can_deallocate_all : std::false_type {};
+    template <typename A>
+    struct can_deallocate_all<A, decltype(void(std::declval<A&>().deallocate_all()), void(std::declval<A const&>().allocated()))>
+        : std::true_type {};
+
+    using fast_clear = std::integral_constant<bool, std::is_trivially_destructible<T>::value
+                                                    && can_deallocate_all<node_allocator>::value>;
+
+    // Such allocators pool nodes and only reuse storage freed one node at a
+    // time, so storage for several nodes is not taken from them as one block.
+    using bulk_storage = std::integral_constant<bool, !can_deallocate_all<node_allocator>::value>;
+
+    bool release_all(std::false_type) noexcept {
+        return false;
+    }
+    bool release_all(std::true_type) noexcept;
+
+    template <typename Compare>
+    static node* merge_chains(node*& a, node*& b, Compare& comp);
 
 public:
+    using value_type = T;
+    using size_type = size_t;
+    using allocator_type = Alloc;
     using iterator = myiterator<T>;
     using const_iterator = myiterator<T const>;
     using reverse_iterator = std::reverse_iterator<iterator>;
     using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
     list();
+    explicit list(Alloc const& alloc);
+    list(size_type n, T const& value, Alloc const& alloc = Alloc());
+    template <typename InputIt, typename = enable_if_iterator<InputIt>>
+    list(InputIt first, InputIt last, Alloc const& alloc = Alloc());
+    list(std::initializer_list<T> init, Alloc const& alloc = Alloc());
     list(list const&);
+    list(list const&, Alloc const& alloc);
+    list(list&&) noexcept;
+    // Overwrites existing elements in place and only allocates or frees the
+    // difference in length. If an element copy throws, the list is left valid
+    // with some elements already replaced; assign_strong has no effect then, at
+    // the cost of building a complete copy first.
     list& operator=(list const&);
+    void assign_strong(list const& other);
+    list& operator=(std::initializer_list<T> init) {
+        assign(init);
+        return *this;
+    }
+    list& operator=(list&&) noexcept(node_traits::propagate_on_container_move_assignment::value
+                                     || node_traits::is_always_equal::value);
     ~list();
 
+    allocator_type get_allocator() const {
+        return allocator_type(node_alloc());
+    }
+
     void clear();
+    template <typename U, typename A>
+    friend void clear_deferred(list<U, A>& c, reaper& r);
     bool empty();
+    size_type size() const noexcept {
+        return count;
+    }
+
+    // Nodes removed by pop, erase and clear keep their storage, up to limit of
+    // them, and later inserts reuse it. The cache is empty and disabled (limit 0)
+    // until requested and is not copied with the list.
+    void set_spare_limit(size_type limit);
+    void prefill_spare(size_type n);
+    size_type spare_count() const noexcept {
+        return spare ? spare->count : 0;
+    }
+    void shrink_to_fit() noexcept;
+
+    // Allocates the storage missing for n elements as one block and caches it,
+    // raising the limit to n. The block is freed once all of its storage has
+    // left the cache, in whichever list its nodes ended up. An allocator that
+    // pools nodes, like pool_allocator, is asked for the nodes one by one.
+    void reserve(size_type n);
+    size_type capacity() const noexcept {
+        return count + spare_count();
+    }
+
+    // Moves the elements, in order, into one newly allocated block so that
+    // traversal walks memory sequentially (into nodes taken one by one from an
+    // allocator that pools them). Invalidates every iterator, pointer
+    // and reference to an element. The old storage is freed and the spare cache
+    // is left as it is. Elements whose move constructor may throw are copied,
+    // and if a copy throws the list is left unchanged.
+    void compact();
 
     void push_back(T const& val);
+    void push_back(T&& val);
+    template <typename... Args>
+    T& emplace_back(Args&&... args);
     void pop_back();
     T& back();
     T const& back() const;
 
     void push_front(T const& val);
+    void push_front(T&& val);
+    template <typename... Args>
+    T& emplace_front(Args&&... args);
     void pop_front();
     T& front();
     T const& front() const;
@@ -107,7 +311,7 @@ public:
         return iterator(&fake);
     }
     const_iterator end() const {
-        return const_iterator(const_cast<node*>(&fake));
+        return const_iterator(const_cast<node*>(static_cast<node const*>(&fake)));
     }
 
     reverse_iterator rbegin() {
@@ -125,20 +329,79 @@ public:
     }
 
     iterator insert(const_iterator pos, T const& val) {
-        fullnode * n = new fullnode(val, pos.cur->left, pos.cur);
+        return emplace(pos, val);
+    }
+    iterator insert(const_iterator pos, T&& val) {
+        return emplace(pos, std::move(val));
+    }
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+        fullnode * n = create_node(pos.cur->left, pos.cur, std::forward<Args>(args)...);
         pos.cur->left = n;
         n->left->right = n;
+        ++count;
         return iterator(n);
     }
+    // The range forms build every new node before linking any, so they either
+    // insert everything or leave the list untouched.
+    iterator insert(const_iterator pos, size_type n, T const& val) {
+        return insert_chain(pos.cur, make_chain(n, val));
+    }
+    template <typename InputIt, typename = enable_if_iterator<InputIt>>
+    iterator insert(const_iterator pos, InputIt first, InputIt last) {
+        return insert_chain(pos.cur, make_chain(first, last));
+    }
+    iterator insert(const_iterator pos, std::initializer_list<T> init) {
+        return insert(pos, init.begin(), init.end());
+    }
+
+    void assign(size_type n, T const& val);
+    template <typename InputIt, typename = enable_if_iterator<InputIt>>
+    void assign(InputIt first, InputIt last);
+    void assign(std::initializer_list<T> init) {
+        assign(init.begin(), init.end());
+    }
+
     iterator erase(const_iterator pos) {
         node* n = pos.cur;
         n->right->left = n->left;
         n->left->right = n->right;
         iterator ans(n->right);
-        delete static_cast<fullnode*>(n);
+        destroy_node(n);
+        --count;
         return ans;
     }
+    iterator erase(const_iterator first, const_iterator last) {
+        first.cur->left->right = last.cur;
+        last.cur->left = first.cur->left;
+        node* cur = first.cur;
+        while (cur != last.cur) {
+            node* to_del = cur;
+            cur = cur->right;
+            destroy_node(to_del);
+            --count;
+        }
+        return iterator(last.cur);
+    }
     void splice(const_iterator pos, list& other, const_iterator first, const_iterator last);
+    void splice(const_iterator pos, list& other, const_iterator first, const_iterator last, size_type n);
+    void splice(const_iterator pos, list& other);
+
+    size_type remove(T const& value);
+    template <typename Predicate>
+    size_type remove_if(Predicate pred);
+
+    size_type unique();
+    template <typename BinaryPredicate>
+    size_type unique(BinaryPredicate pred);
+
+    void merge(list& other);
+    template <typename Compare>
+    void merge(list& other, Compare comp);
+
+    void sort();
+    template <typename Compare>
+    void sort(Compare comp);
 
     void swap(list& other);
 
@@ -147,102 +410,431 @@ public:
     }
 };
 
-template<typename T>
-list<T>::list() = default;
+template<typename T, typename Alloc>
+list<T, Alloc>::list() = default;
 
-template<typename T>
-list<T>::list(list const & other) : list() {
-    for(T const &v : other) {
-        push_back(v);
-    }
+template<typename T, typename Alloc>
+list<T, Alloc>::list(Alloc const& alloc) : fake(node_allocator(alloc)) {}
+
+template<typename T, typename Alloc>
+list<T, Alloc>::list(size_type n, T const& value, Alloc const& alloc) : list(alloc) {
+    insert_chain(&fake, make_chain(n, value));
+}
+
+template<typename T, typename Alloc>
+template<typename InputIt, typename>
+list<T, Alloc>::list(InputIt first, InputIt last, Alloc const& alloc) : list(alloc) {
+    insert_chain(&fake, make_chain(first, last));
+}
+
+template<typename T, typename Alloc>
+list<T, Alloc>::list(std::initializer_list<T> init, Alloc const& alloc) : list(init.begin(), init.end(), alloc) {}
+
+template<typename T, typename Alloc>
+list<T, Alloc>::list(list const & other)
+    : list(other, Alloc(node_traits::select_on_container_copy_construction(other.node_alloc()))) {}
+
+template<typename T, typename Alloc>
+list<T, Alloc>::list(list const & other, Alloc const& alloc) : list(alloc) {
+    insert_chain(&fake, make_chain(other.begin(), other.end()));
 }
 
-template<typename T>
-list<T>::~list() {
+template<typename T, typename Alloc>
+list<T, Alloc>::list(list && other) noexcept : fake(other.node_alloc()) {
+    swap_nodes(other);
+    std::swap(spare, other.spare);
+}
+
+template<typename T, typename Alloc>
+list<T, Alloc>::~list() {
     clear();
+    release_spare();
+}
+
+template<typename T, typename Alloc>
+typename list<T, Alloc>::stored* list<T, Alloc>::acquire_storage() {
+    if (spare && spare->head) {
+        node* n = spare->head;
+        spare->head = n->right;
+        --spare->count;
+        return static_cast<stored*>(n);
+    }
+    return new (static_cast<void*>(node_traits::allocate(node_alloc(), 1))) stored(nullptr, nullptr, nullptr);
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::release_storage(fullnode* p, block_header* block) noexcept {
+    if (spare && spare->count < spare->limit) {
+        spare->head = new (static_cast<void*>(p)) stored(nullptr, spare->head, block);
+        ++spare->count;
+        return;
+    }
+    return_storage(node_alloc(), p, block);
+}
+
+// Hands storage back to the allocator, or to its block.
+template<typename T, typename Alloc>
+void list<T, Alloc>::return_storage(node_allocator& alloc, fullnode* p, block_header* block) noexcept {
+    if (!block) {
+        node_traits::deallocate(alloc, p, 1);
+        return;
+    }
+    if (--block->live == 0) {
+        size_t nodes = block->nodes;
+        block->~block_header();
+        node_traits::deallocate(alloc, static_cast<fullnode*>(static_cast<void*>(block)), nodes);
+    }
+}
+
+// Allocates a block for n nodes and returns its storage as a null-terminated
+// chain in address order.
+template<typename T, typename Alloc>
+typename list<T, Alloc>::stored* list<T, Alloc>::new_block(size_t n) {
+    fullnode* first = node_traits::allocate(node_alloc(), n + 1);
+    auto* block = new (static_cast<void*>(first)) block_header(n + 1);
+    node* next = nullptr;
+    for (size_t i = n; i != 0; --i) {
+        next = new (static_cast<void*>(first + i)) stored(nullptr, next, block);
+    }
+    return static_cast<stored*>(next);
+}
+
+// Allocates storage for n nodes one by one and returns it as a null-terminated chain.
+template<typename T, typename Alloc>
+typename list<T, Alloc>::stored* list<T, Alloc>::new_storage(size_t n, std::false_type) {
+    node* head = nullptr;
+    node** tail = &head;
+    try {
+        for (; n != 0; --n) {
+            *tail = new (static_cast<void*>(node_traits::allocate(node_alloc(), 1))) stored(nullptr, nullptr, nullptr);
+            tail = &(*tail)->right;
+        }
+    } catch (...) {
+        while (head) {
+            node* p = head;
+            head = head->right;
+            node_traits::deallocate(node_alloc(), static_cast<fullnode*>(p), 1);
+        }
+        throw;
+    }
+    return static_cast<stored*>(head);
+}
+
+template<typename T, typename Alloc>
+template<typename... Args>
+typename list<T, Alloc>::fullnode* list<T, Alloc>::create_node(node* left, node* right, Args&&... args) {
+    stored* s = acquire_storage();
+    block_header* block = s->block;
+    fullnode* p = static_cast<fullnode*>(s);
+    try {
+        return new (p) fullnode(left, right, block, std::forward<Args>(args)...);
+    } catch (...) {
+        release_storage(p, block);
+        throw;
+    }
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::destroy_node(node* n) noexcept {
+    fullnode* p = static_cast<fullnode*>(n);
+    block_header* block = p->block;
+    p->~fullnode();
+    release_storage(p, block);
+}
+
+template<typename T, typename Alloc>
+typename list<T, Alloc>::spare_store& list<T, Alloc>::spare_storage() {
+    if (!spare) {
+        spare = new (static_cast<void*>(node_traits::allocate(node_alloc(), 1))) spare_store();
+    }
+    return *spare;
+}
+
+// Frees the cache together with its bookkeeping.
+template<typename T, typename Alloc>
+void list<T, Alloc>::release_spare() noexcept {
+    if (!spare) {
+        return;
+    }
+    shrink_to_fit();
+    spare->~spare_store();
+    node_traits::deallocate(node_alloc(), static_cast<fullnode*>(static_cast<void*>(spare)), 1);
+    spare = nullptr;
+}
+
+// Frees cached nodes until at most keep remain.
+template<typename T, typename Alloc>
+void list<T, Alloc>::trim_spare(size_t keep) noexcept {
+    while (spare->count > keep) {
+        stored* s = static_cast<stored*>(spare->head);
+        spare->head = s->right;
+        --spare->count;
+        return_storage(node_alloc(), static_cast<fullnode*>(s), s->block);
+    }
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::set_spare_limit(size_type limit) {
+    if (!spare && limit == 0) {
+        return;
+    }
+    spare_storage().limit = limit;
+    trim_spare(limit);
+}
+
+// Allocates storage until n nodes are cached, raising the limit if needed.
+template<typename T, typename Alloc>
+void list<T, Alloc>::prefill_spare(size_type n) {
+    spare_store& s = spare_storage();
+    s.limit = std::max(s.limit, n);
+    while (s.count < n) {
+        s.head = new (static_cast<void*>(node_traits::allocate(node_alloc(), 1))) stored(nullptr, s.head, nullptr);
+        ++s.count;
+    }
+}
+
+// Frees every cached node; the limit is kept.
+template<typename T, typename Alloc>
+void list<T, Alloc>::shrink_to_fit() noexcept {
+    if (spare) {
+        trim_spare(0);
+    }
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::reserve(size_type n) {
+    if (n <= capacity()) {
+        return;
+    }
+    size_type missing = n - capacity();
+    spare_store& s = spare_storage();
+    // Put in front of the cache so that inserts use the block in address order.
+    node* head = new_storage(missing);
+    node* last = head;
+    while (last->right) {
+        last = last->right;
+    }
+    last->right = s.head;
+    s.head = head;
+    s.count += missing;
+    s.limit = std::max(s.limit, n);
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::compact() {
+    if (count == 0) {
+        return;
+    }
+    node* cur = fake.right;
+    chain c = make_chain(new_storage(count), [&cur](fullnode* p, node* left, block_header* block) {
+        new (p) fullnode(left, nullptr, block, std::move_if_noexcept(static_cast<fullnode*>(cur)->val));
+        cur = cur->right;
+    });
+    cur = fake.right;
+    while (cur != &fake) {
+        fullnode* old = static_cast<fullnode*>(cur);
+        cur = cur->right;
+        block_header* block = old->block;
+        old->~fullnode();
+        return_storage(node_alloc(), old, block);
+    }
+    adopt_chain(c.head);
+}
+
+// When the allocator holds nothing but this list's nodes and the bookkeeping
+// of its spare cache, and T needs no destructor, the nodes are handed back all
+// at once. A cache holding nodes keeps being fed instead. Storage for several
+// nodes is never taken from such allocators, so there are no block headers to
+// account for. The bookkeeping goes back with the nodes and is allocated again
+// to keep the limit; if that fails the cache is left disabled.
+template<typename T, typename Alloc>
+bool list<T, Alloc>::release_all(std::true_type) noexcept {
+    if (spare_count() != 0 || node_alloc().allocated() != count + (spare ? 1 : 0)) {
+        return false;
+    }
+    size_t limit = spare ? spare->limit : 0;
+    node_alloc().deallocate_all();
+    spare = nullptr;
+    fake.right = fake.left = &fake;
+    count = 0;
+    if (limit != 0) {
+        try {
+            spare_storage().limit = limit;
+        } catch (...) {
+        }
+    }
+    return true;
 }
 
-template<typename T>
-void list<T>::clear() {
+template<typename T, typename Alloc>
+void list<T, Alloc>::clear() {
+    if (count != 0 && release_all(fast_clear())) {
+        return;
+    }
     node* cur = fake.right;
     while (cur != &fake) {
         node* to_del = cur;
         cur = cur->right;
-        delete static_cast<fullnode*>(to_del);
+        destroy_node(to_del);
     }
     fake.right = fake.left = &fake;
+    count = 0;
 }
 
-template<typename T>
-bool list<T>::empty() {
+template<typename T, typename Alloc>
+bool list<T, Alloc>::empty() {
     return fake.right == &fake;
 }
 
-template<typename T>
-void list<T>::push_back(const T &val) {
-    auto * v = new fullnode(val, fake.left, &fake);
+template<typename T, typename Alloc>
+void list<T, Alloc>::push_back(const T &val) {
+    emplace_back(val);
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::push_back(T &&val) {
+    emplace_back(std::move(val));
+}
+
+template<typename T, typename Alloc>
+template<typename... Args>
+T &list<T, Alloc>::emplace_back(Args&&... args) {
+    auto * v = create_node(fake.left, &fake, std::forward<Args>(args)...);
     fake.left->right = v;
     fake.left = v;
+    ++count;
+    return v->val;
 }
 
-template<typename T>
-void list<T>::pop_back() {
+template<typename T, typename Alloc>
+void list<T, Alloc>::pop_back() {
     if(empty()) {
         return;
     }
     node *l = fake.left;
     fake.left = l->left;
     l->left->right = &fake;
-    delete static_cast<fullnode*>(l);
+    destroy_node(l);
+    --count;
 }
 
-template<typename T>
-T &list<T>::back() {
+template<typename T, typename Alloc>
+T &list<T, Alloc>::back() {
     return (static_cast<fullnode*>(fake.left))->val;
 }
 
-template<typename T>
-T const &list<T>::back() const {
+template<typename T, typename Alloc>
+T const &list<T, Alloc>::back() const {
     return (static_cast<fullnode const*>(fake.left))->val;
 }
 
-template<typename T>
-void list<T>::push_front(const T &val) {
-    auto * v = new fullnode(val, &fake, fake.right);
+template<typename T, typename Alloc>
+void list<T, Alloc>::push_front(const T &val) {
+    emplace_front(val);
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::push_front(T &&val) {
+    emplace_front(std::move(val));
+}
+
+template<typename T, typename Alloc>
+template<typename... Args>
+T &list<T, Alloc>::emplace_front(Args&&... args) {
+    auto * v = create_node(&fake, fake.right, std::forward<Args>(args)...);
     fake.right->left = v;
     fake.right = v;
+    ++count;
+    return v->val;
 }
 
-template<typename T>
-T &list<T>::front() {
+template<typename T, typename Alloc>
+T &list<T, Alloc>::front() {
     return (static_cast<fullnode*>(fake.right))->val;
 }
 
-template<typename T>
-void list<T>::pop_front() {
+template<typename T, typename Alloc>
+void list<T, Alloc>::pop_front() {
     if(empty()) {
         return;
     }
     node *r = fake.right;
     fake.right = r->right;
     r->right->left = &fake;
-    delete static_cast<fullnode*>(r);
+    destroy_node(r);
+    --count;
 }
 
-template<typename T>
-T const &list<T>::front() const {
+template<typename T, typename Alloc>
+T const &list<T, Alloc>::front() const {
     return (static_cast<fullnode const*>(fake.right))->val;
 }
 
-template<typename T>
-list<T> &list<T>::operator=(list const & other) {
-    list<T> t = other;
-    swap(t);
+template<typename T, typename Alloc>
+list<T, Alloc> &list<T, Alloc>::operator=(list const & other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (node_traits::propagate_on_container_copy_assignment::value && node_alloc() != other.node_alloc()) {
+        // Existing nodes belong to the old allocator and cannot be kept.
+        assign_strong(other);
+        return *this;
+    }
+    node* cur = fake.right;
+    const_iterator src = other.begin();
+    for (; cur != &fake && src != other.end(); cur = cur->right, ++src) {
+        static_cast<fullnode*>(cur)->val = *src;
+    }
+    if (src != other.end()) {
+        insert_chain(&fake, make_chain(src, other.end()));
+    } else {
+        erase(const_iterator(cur), end());
+    }
+    return *this;
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::assign_strong(list const& other) {
+    if (this == &other) {
+        return;
+    }
+    constexpr bool propagate = node_traits::propagate_on_container_copy_assignment::value;
+    list t(other, Alloc(propagate ? other.node_alloc() : node_alloc()));
+    clear();
+    if (propagate) {
+        release_spare();
+        node_alloc() = other.node_alloc();
+    }
+    swap_nodes(t);
+}
+
+template<typename T, typename Alloc>
+list<T, Alloc> &list<T, Alloc>::operator=(list && other)
+        noexcept(node_traits::propagate_on_container_move_assignment::value
+                 || node_traits::is_always_equal::value) {
+    if (this == &other) {
+        return *this;
+    }
+    clear();
+    if (node_traits::propagate_on_container_move_assignment::value) {
+        release_spare();
+        node_alloc() = std::move(other.node_alloc());
+    } else if (node_alloc() != other.node_alloc()) {
+        for (T &v : other) {
+            push_back(std::move(v));
+        }
+        other.clear();
+        return *this;
+    } else {
+        release_spare();
+    }
+    swap_nodes(other);
+    std::swap(spare, other.spare);
     return *this;
 }
 
-template<typename T>
-void list<T>::swap(list &other) {
+template<typename T, typename Alloc>
+void list<T, Alloc>::swap_nodes(list &other) noexcept {
     node* a_l = fake.left;
     node* a_r = fake.right;
     node* b_l = other.fake.left;
@@ -251,11 +843,41 @@ void list<T>::swap(list &other) {
     a_r->left = &other.fake;
     b_l->right = &fake;
     b_r->left = &fake;
-    std::swap(fake, other.fake);
+    std::swap(fake.left, other.fake.left);
+    std::swap(fake.right, other.fake.right);
+    std::swap(count, other.count);
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::swap(list &other) {
+    if (node_traits::propagate_on_container_swap::value) {
+        using std::swap;
+        swap(node_alloc(), other.node_alloc());
+    } else {
+        assert(node_alloc() == other.node_alloc());
+    }
+    swap_nodes(other);
+    std::swap(spare, other.spare);
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::splice(list::const_iterator pos, list &other, list::const_iterator first, list::const_iterator last) {
+    splice(pos, other, first, last, &other == this ? 0 : std::distance(first, last));
 }
 
-template<typename T>
-void list<T>::splice(list::const_iterator pos, list &other, list::const_iterator first, list::const_iterator last) {
+template<typename T, typename Alloc>
+void list<T, Alloc>::splice(list::const_iterator pos, list &other) {
+    splice(pos, other, other.begin(), other.end(), other.count);
+}
+
+// n is the number of elements in [first, last) and is ignored for splices within one list.
+template<typename T, typename Alloc>
+void list<T, Alloc>::splice(list::const_iterator pos, list &other, list::const_iterator first, list::const_iterator last, size_type n) {
+    assert(&other == this || node_alloc() == other.node_alloc());
+    if (&other != this) {
+        count += n;
+        other.count -= n;
+    }
     node* l = first.cur->left;
 
     pos.cur->left->right = first.cur;
@@ -268,3 +890,415 @@ void list<T>::splice(list::const_iterator pos, list &other, list::const_iterator
     l->right = last.cur;
 }
 
+// Moves n to the end of a detached null-terminated chain and returns its successor.
+template<typename T, typename Alloc>
+typename list<T, Alloc>::node* list<T, Alloc>::unlink(node* n, node**& tail) noexcept {
+    node* next = n->right;
+    n->left->right = next;
+    next->left = n->left;
+    n->right = nullptr;
+    *tail = n;
+    tail = &n->right;
+    --count;
+    return next;
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::destroy_chain(node* head) noexcept {
+    while (head) {
+        node* to_del = head;
+        head = head->right;
+        destroy_node(to_del);
+    }
+}
+
+// Takes storage for n nodes as a null-terminated chain: cached storage first,
+// then whatever is missing from one block.
+template<typename T, typename Alloc>
+typename list<T, Alloc>::node* list<T, Alloc>::take_storage(size_t n) {
+    node* head = nullptr;
+    node** tail = &head;
+    for (; n != 0 && spare && spare->head; --n) {
+        node* p = acquire_storage();
+        p->right = nullptr;
+        *tail = p;
+        tail = &p->right;
+    }
+    if (n == 0) {
+        return head;
+    }
+    try {
+        *tail = n == 1 ? acquire_storage() : new_storage(n);
+    } catch (...) {
+        release_storage_chain(head);
+        throw;
+    }
+    return head;
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::release_storage_chain(node* head) noexcept {
+    while (head) {
+        node* p = head;
+        head = head->right;
+        release_storage(static_cast<fullnode*>(p), static_cast<stored*>(p)->block);
+    }
+}
+
+// Builds a node in every piece of a storage chain with construct(storage, left,
+// block), which must placement-new a fullnode.
+template<typename T, typename Alloc>
+template<typename Construct>
+typename list<T, Alloc>::chain list<T, Alloc>::make_chain(node* storage, Construct construct) {
+    chain c;
+    // The piece being built; a failed construction may have overwritten its links.
+    fullnode* p = nullptr;
+    block_header* block = nullptr;
+    try {
+        while (storage) {
+            stored* s = static_cast<stored*>(storage);
+            storage = s->right;
+            block = s->block;
+            p = static_cast<fullnode*>(s);
+            construct(p, c.tail, block);
+            if (c.tail) {
+                c.tail->right = p;
+            } else {
+                c.head = p;
+            }
+            c.tail = p;
+            p = nullptr;
+            ++c.n;
+        }
+    } catch (...) {
+        destroy_chain(c.head);
+        if (p) {
+            release_storage(p, block);
+        }
+        release_storage_chain(storage);
+        throw;
+    }
+    return c;
+}
+
+template<typename T, typename Alloc>
+template<typename InputIt>
+typename list<T, Alloc>::chain list<T, Alloc>::make_chain(InputIt first, InputIt last, std::input_iterator_tag) {
+    chain c;
+    try {
+        for (; first != last; ++first) {
+            fullnode* p = create_node(c.tail, nullptr, *first);
+            if (c.tail) {
+                c.tail->right = p;
+            } else {
+                c.head = p;
+            }
+            c.tail = p;
+            ++c.n;
+        }
+    } catch (...) {
+        destroy_chain(c.head);
+        throw;
+    }
+    return c;
+}
+
+template<typename T, typename Alloc>
+template<typename ForwardIt>
+typename list<T, Alloc>::chain list<T, Alloc>::make_chain(ForwardIt first, ForwardIt last, std::forward_iterator_tag) {
+    return make_chain(static_cast<size_t>(std::distance(first, last)), [&first](fullnode* p, node* left, block_header* block) {
+        new (p) fullnode(left, nullptr, block, *first);
+        ++first;
+    });
+}
+
+template<typename T, typename Alloc>
+typename list<T, Alloc>::chain list<T, Alloc>::make_chain(size_t n, T const& value) {
+    return make_chain(n, [&value](fullnode* p, node* left, block_header* block) {
+        new (p) fullnode(left, nullptr, block, value);
+    });
+}
+
+// Links a detached chain in front of pos and returns an iterator to its first
+// node, or to pos if the chain is empty.
+template<typename T, typename Alloc>
+typename list<T, Alloc>::iterator list<T, Alloc>::insert_chain(node* pos, chain c) noexcept {
+    if (c.n == 0) {
+        return iterator(pos);
+    }
+    c.head->left = pos->left;
+    pos->left->right = c.head;
+    c.tail->right = pos;
+    pos->left = c.tail;
+    count += c.n;
+    return iterator(c.head);
+}
+
+// The new elements are built before the old ones are destroyed, so assign has
+// no effect if it throws.
+template<typename T, typename Alloc>
+void list<T, Alloc>::assign(size_type n, T const& val) {
+    chain c = make_chain(n, val);
+    clear();
+    insert_chain(&fake, c);
+}
+
+template<typename T, typename Alloc>
+template<typename InputIt, typename>
+void list<T, Alloc>::assign(InputIt first, InputIt last) {
+    chain c = make_chain(first, last);
+    clear();
+    insert_chain(&fake, c);
+}
+
+template<typename T, typename Alloc>
+typename list<T, Alloc>::size_type list<T, Alloc>::remove(T const& value) {
+    return remove_if([&value](T const& v) { return v == value; });
+}
+
+// Matching nodes are unlinked in one pass and destroyed afterwards, so pred and
+// value may refer to elements of the list.
+template<typename T, typename Alloc>
+template<typename Predicate>
+typename list<T, Alloc>::size_type list<T, Alloc>::remove_if(Predicate pred) {
+    size_type old_count = count;
+    node* removed = nullptr;
+    node** tail = &removed;
+    try {
+        node* cur = fake.right;
+        while (cur != &fake) {
+            if (pred(static_cast<fullnode*>(cur)->val)) {
+                cur = unlink(cur, tail);
+            } else {
+                cur = cur->right;
+            }
+        }
+    } catch (...) {
+        destroy_chain(removed);
+        throw;
+    }
+    destroy_chain(removed);
+    return old_count - count;
+}
+
+template<typename T, typename Alloc>
+typename list<T, Alloc>::size_type list<T, Alloc>::unique() {
+    return unique(std::equal_to<T>());
+}
+
+// Removes every element equal (by pred) to the first element of its run of
+// consecutive equal elements, using the same deferred destruction as remove_if.
+template<typename T, typename Alloc>
+template<typename BinaryPredicate>
+typename list<T, Alloc>::size_type list<T, Alloc>::unique(BinaryPredicate pred) {
+    if (count < 2) {
+        return 0;
+    }
+    size_type old_count = count;
+    node* removed = nullptr;
+    node** tail = &removed;
+    try {
+        node* kept = fake.right;
+        node* cur = kept->right;
+        while (cur != &fake) {
+            if (pred(static_cast<fullnode*>(kept)->val, static_cast<fullnode*>(cur)->val)) {
+                cur = unlink(cur, tail);
+            } else {
+                kept = cur;
+                cur = cur->right;
+            }
+        }
+    } catch (...) {
+        destroy_chain(removed);
+        throw;
+    }
+    destroy_chain(removed);
+    return old_count - count;
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::merge(list &other) {
+    merge(other, std::less<T>());
+}
+
+// Moves runs of other's nodes in front of the first element of *this they precede.
+// Equal elements of *this stay first. If comp throws, both lists stay valid.
+template<typename T, typename Alloc>
+template<typename Compare>
+void list<T, Alloc>::merge(list &other, Compare comp) {
+    if (&other == this) {
+        return;
+    }
+    node* cur = fake.right;
+    while (!other.empty()) {
+        if (cur == &fake) {
+            splice(end(), other);
+            return;
+        }
+        node* first = other.fake.right;
+        T const& pivot = static_cast<fullnode*>(cur)->val;
+        if (!comp(static_cast<fullnode*>(first)->val, pivot)) {
+            cur = cur->right;
+            continue;
+        }
+        node* last = first->right;
+        size_type n = 1;
+        while (last != &other.fake && comp(static_cast<fullnode*>(last)->val, pivot)) {
+            last = last->right;
+            ++n;
+        }
+        splice(const_iterator(cur), other, const_iterator(first), const_iterator(last), n);
+    }
+}
+
+// Relinks a null-terminated chain threaded through right pointers as the whole list.
+template<typename T, typename Alloc>
+void list<T, Alloc>::adopt_chain(node* head) noexcept {
+    node* prev = &fake;
+    for (node* cur = head; cur; cur = cur->right) {
+        prev->right = cur;
+        cur->left = prev;
+        prev = cur;
+    }
+    prev->right = &fake;
+    fake.left = prev;
+}
+
+// Stably merges two sorted null-terminated chains, consuming both. If comp throws,
+// a holds every node of both chains and b is empty.
+template<typename T, typename Alloc>
+template<typename Compare>
+typename list<T, Alloc>::node* list<T, Alloc>::merge_chains(node*& a, node*& b, Compare& comp) {
+    node* head = nullptr;
+    node** tail = &head;
+    try {
+        while (a && b) {
+            if (comp(static_cast<fullnode*>(b)->val, static_cast<fullnode*>(a)->val)) {
+                *tail = b;
+                b = b->right;
+            } else {
+                *tail = a;
+                a = a->right;
+            }
+            tail = &(*tail)->right;
+        }
+    } catch (...) {
+        *tail = a;
+        while (*tail) {
+            tail = &(*tail)->right;
+        }
+        *tail = b;
+        a = head;
+        b = nullptr;
+        throw;
+    }
+    *tail = a ? a : b;
+    a = b = nullptr;
+    return head;
+}
+
+template<typename T, typename Alloc>
+void list<T, Alloc>::sort() {
+    sort(std::less<T>());
+}
+
+// Bottom-up merge sort: buckets[i] holds a sorted run of 2^i nodes. Only pointers
+// are relinked; if comp throws, every node is put back in some unspecified order.
+template<typename T, typename Alloc>
+template<typename Compare>
+void list<T, Alloc>::sort(Compare comp) {
+    if (count < 2) {
+        return;
+    }
+    node* rest = fake.right;
+    fake.left->right = nullptr;
+
+    node* buckets[sizeof(size_type) * 8 + 1] = {};
+    node* carry = nullptr;
+    try {
+        while (rest) {
+            carry = rest;
+            rest = rest->right;
+            carry->right = nullptr;
+            size_type i = 0;
+            for (; buckets[i]; ++i) {
+                carry = merge_chains(buckets[i], carry, comp);
+            }
+            buckets[i] = carry;
+            carry = nullptr;
+        }
+        for (node*& bucket : buckets) {
+            if (bucket) {
+                carry = merge_chains(bucket, carry, comp);
+            }
+        }
+    } catch (...) {
+        node* head = nullptr;
+        node** tail = &head;
+        auto append = [&tail](node* chain) {
+            *tail = chain;
+            while (*tail) {
+                tail = &(*tail)->right;
+            }
+        };
+        append(rest);
+        append(carry);
+        for (node* bucket : buckets) {
+            append(bucket);
+        }
+        adopt_chain(head);
+        throw;
+    }
+    adopt_chain(carry);
+}
+
+template <typename T, typename Alloc, typename ListIt>
+void merge_all(list<T, Alloc>& dest, ListIt first, ListIt last) {
+    merge_all(dest, first, last, std::less<T>());
+}
+
+// k-way merge of the sorted lists in [first, last) into the sorted list dest using a
+// heap over the list heads: O(n log k) comparisons, no node is allocated or copied.
+// Equal elements keep the order dest, *first, ... If anything throws, every element
+// is still in dest or in its source list. Only the elements of dest move out while
+// merging; its spare cache and reserved storage stay with it.
+template <typename T, typename Alloc, typename ListIt, typename Compare>
+void merge_all(list<T, Alloc>& dest, ListIt first, ListIt last, Compare comp) {
+    list<T, Alloc> own(dest.get_allocator());
+    own.splice(own.end(), dest);
+    std::vector<list<T, Alloc>*> runs;
+    try {
+        runs.push_back(&own);
+        for (; first != last; ++first) {
+            runs.push_back(&*first);
+        }
+
+        std::vector<size_t> heap;
+        heap.reserve(runs.size());
+        auto after = [&runs, &comp](size_t a, size_t b) {
+            T const& x = runs[a]->front();
+            T const& y = runs[b]->front();
+            return comp(y, x) || (!comp(x, y) && b < a);
+        };
+        for (size_t i = 0; i != runs.size(); ++i) {
+            if (!runs[i]->empty()) {
+                heap.push_back(i);
+                std::push_heap(heap.begin(), heap.end(), after);
+            }
+        }
+
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), after);
+            list<T, Alloc>& src = *runs[heap.back()];
+            dest.splice(dest.end(), src, src.begin(), std::next(src.begin()), 1);
+            if (src.empty()) {
+                heap.pop_back();
+            } else {
+                std::push_heap(heap.begin(), heap.end(), after);
+            }
+        }
+    } catch (...) {
+        dest.splice(dest.end(), own);
+        throw;
+    }
+}
@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "list.h"
+#include "node_pool.h"
+#include "unrolled_list.h"
+
+// Throughput of list<T>, alone and with pool_allocator, and of unrolled_list<T>
+// against std::list, std::deque and std::vector. Every operation is timed for
+// each element type and for sizes 10, 100, ... up to the limit given as the
+// first argument (10^7 by default). Results are printed to stdout as one JSON
+// document; times are nanoseconds per element or per call. For list, traversal
+// is also timed with the nodes scattered in memory and again after compact().
+// Sorting uses the member sort of the lists and std::stable_sort elsewhere.
+
+namespace
+{
+    struct pod64
+    {
+        long long data[8];
+    };
+
+    bool operator<(pod64 const& a, pod64 const& b)
+    {
+        return a.data[0] < b.data[0];
+    }
+
+    template <typename T>
+    T make(size_t i);
+
+    template <>
+    int make<int>(size_t i)
+    {
+        return static_cast<int>(i);
+    }
+
+    template <>
+    pod64 make<pod64>(size_t i)
+    {
+        pod64 result;
+        for (long long& d : result.data)
+            d = static_cast<long long>(i);
+        return result;
+    }
+
+    template <>
+    std::string make<std::string>(size_t i)
+    {
+        // Long enough to defeat the small string optimisation.
+        std::string result = std::to_string(i);
+        result.resize(32, '.');
+        return result;
+    }
+
+    size_t weight(int x)
+    {
+        return static_cast<size_t>(x);
+    }
+
+    size_t weight(pod64 const& x)
+    {
+        return static_cast<size_t>(x.data[0]);
+    }
+
+    size_t weight(std::string const& x)
+    {
+        return x.size();
+    }
+
+    volatile size_t sink;
+
+    template <typename C>
+    struct traits
+    {
+        static constexpr bool push_front = true;
+        static constexpr bool splice = false;
+        static constexpr bool compact = false;
+        static constexpr bool member_sort = false;
+    };
+
+    template <typename T, typename A>
+    struct traits<std::vector<T, A>>
+    {
+        static constexpr bool push_front = false;
+        static constexpr bool splice = false;
+        static constexpr bool compact = false;
+        static constexpr bool member_sort = false;
+    };
+
+    template <typename T, typename A>
+    struct traits<std::list<T, A>>
+    {
+        static constexpr bool push_front = true;
+        static constexpr bool splice = true;
+        static constexpr bool compact = false;
+        static constexpr bool member_sort = true;
+    };
+
+    template <typename T, typename A>
+    struct traits<list<T, A>>
+    {
+        static constexpr bool push_front = true;
+        static constexpr bool splice = true;
+        static constexpr bool compact = true;
+        static constexpr bool member_sort = true;
+    };
+
+    // Lists filled separately have separate pools and cannot exchange nodes.
+    template <typename T>
+    struct traits<list<T, pool_allocator<T>>>
+    {
+        static constexpr bool push_front = true;
+        static constexpr bool splice = false;
+        static constexpr bool compact = true;
+        static constexpr bool member_sort = true;
+    };
+
+    template <typename T, size_t K, typename A>
+    struct traits<unrolled_list<T, K, A>>
+    {
+        static constexpr bool push_front = true;
+        static constexpr bool splice = true;
+        static constexpr bool compact = false;
+        static constexpr bool member_sort = false;
+    };
+
+    struct reporter
+    {
+        bool first = true;
+
+        void operator()(char const* container, char const* type, char const* op, size_t n, double ns)
+        {
+            std::printf("%s\n    {\"container\": \"%s\", \"type\": \"%s\", \"op\": \"%s\", \"n\": %zu, \"ns\": %.3f}",
+                        first ? "" : ",", container, type, op, n, ns);
+            first = false;
+        }
+    };
+
+    using bench_clock = std::chrono::steady_clock;
+
+    double ns_since(bench_clock::time_point start, size_t ops)
+    {
+        std::chrono::duration<double, std::nano> elapsed = bench_clock::now() - start;
+        return elapsed.count() / static_cast<double>(ops);
+    }
+
+    template <typename C>
+    C filled(size_t n)
+    {
+        C c;
+        for (size_t i = 0; i != n; ++i)
+            c.push_back(make<typename C::value_type>(i));
+        return c;
+    }
+
+    template <typename C>
+    double traverse(C const& c)
+    {
+        auto start = bench_clock::now();
+        size_t sum = 0;
+        for (auto const& v : c)
+            sum += weight(v);
+        sink = sum;
+        return ns_since(start, c.size());
+    }
+
+    template <typename C, bool = traits<C>::push_front>
+    struct front_ops
+    {
+        static double push(size_t n)
+        {
+            C c;
+            auto start = bench_clock::now();
+            for (size_t i = 0; i != n; ++i)
+                c.push_front(make<typename C::value_type>(i));
+            return ns_since(start, n);
+        }
+
+        static double pop(size_t n)
+        {
+            C c = filled<C>(n);
+            auto start = bench_clock::now();
+            for (size_t i = 0; i != n; ++i)
+                c.pop_front();
+            return ns_since(start, n);
+        }
+    };
+
+    template <typename C>
+    struct front_ops<C, false>
+    {
+        static double push(size_t)
+        {
+            return -1;
+        }
+
+        static double pop(size_t)
+        {
+            return -1;
+        }
+    };
+
+    template <typename C, bool = traits<C>::splice>
+    struct splice_ops
+    {
+        // Moves a whole list back and forth between two lists.
+        static double run(size_t n, size_t calls)
+        {
+            C a = filled<C>(n);
+            C b = filled<C>(n);
+            auto start = bench_clock::now();
+            for (size_t i = 0; i != calls; ++i)
+            {
+                b.splice(b.begin(), a);
+                a.splice(a.end(), b);
+            }
+            sink = a.size() + b.size();
+            return ns_since(start, 2 * calls);
+        }
+    };
+
+    template <typename C>
+    struct splice_ops<C, false>
+    {
+        static double run(size_t, size_t)
+        {
+            return -1;
+        }
+    };
+
+    template <typename C, bool = traits<C>::compact>
+    struct compact_ops
+    {
+        // Sorting by a hash of the element address relinks the nodes in an
+        // order unrelated to where they live.
+        static void scatter(C& c)
+        {
+            using T = typename C::value_type;
+            auto key = [](T const& x) {
+                return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(&x)) * 0x9e3779b97f4a7c15ull;
+            };
+            c.sort([&key](T const& a, T const& b) { return key(a) < key(b); });
+        }
+
+        template <typename Emit>
+        static void run(Emit& emit, size_t n)
+        {
+            C c = filled<C>(n);
+            scatter(c);
+            emit("traverse_scattered", traverse(c));
+            auto start = bench_clock::now();
+            c.compact();
+            emit("compact", ns_since(start, n));
+            emit("traverse_compacted", traverse(c));
+        }
+    };
+
+    template <typename C>
+    struct compact_ops<C, false>
+    {
+        template <typename Emit>
+        static void run(Emit&, size_t)
+        {
+        }
+    };
+
+    template <typename C>
+    C shuffled(size_t n)
+    {
+        std::mt19937 gen(42);
+        C c;
+        for (size_t i = 0; i != n; ++i)
+            c.push_back(make<typename C::value_type>(gen()));
+        return c;
+    }
+
+    template <typename C>
+    using random_access = std::is_same<typename std::iterator_traits<typename C::iterator>::iterator_category,
+                                       std::random_access_iterator_tag>;
+
+    template <typename C, bool = traits<C>::member_sort, bool = random_access<C>::value>
+    struct sort_ops
+    {
+        static double run(size_t)
+        {
+            return -1;
+        }
+    };
+
+    template <typename C, bool RandomAccess>
+    struct sort_ops<C, true, RandomAccess>
+    {
+        static double run(size_t n)
+        {
+            C c = shuffled<C>(n);
+            auto start = bench_clock::now();
+            c.sort();
+            return ns_since(start, n);
+        }
+    };
+
+    template <typename C>
+    struct sort_ops<C, false, true>
+    {
+        static double run(size_t n)
+        {
+            C c = shuffled<C>(n);
+            auto start = bench_clock::now();
+            std::stable_sort(c.begin(), c.end());
+            return ns_since(start, n);
+        }
+    };
+
+    template <typename C>
+    void run_cases(reporter& report, char const* container, char const* type, size_t n)
+    {
+        using T = typename C::value_type;
+        size_t const calls = 1000;
+        size_t const middle_ops = n < 1000 ? n : 1000;
+
+        auto emit = [&](char const* op, double ns) {
+            if (ns >= 0)
+                report(container, type, op, n, ns);
+        };
+
+        {
+            C c;
+            auto start = bench_clock::now();
+            for (size_t i = 0; i != n; ++i)
+                c.push_back(make<T>(i));
+            emit("push_back", ns_since(start, n));
+        }
+        {
+            C c = filled<C>(n);
+            auto start = bench_clock::now();
+            for (size_t i = 0; i != n; ++i)
+                c.pop_back();
+            emit("pop_back", ns_since(start, n));
+        }
+        emit("push_front", front_ops<C>::push(n));
+        emit("pop_front", front_ops<C>::pop(n));
+        {
+            C c = filled<C>(n);
+            auto it = std::next(c.begin(), n / 2);
+            auto start = bench_clock::now();
+            for (size_t i = 0; i != middle_ops; ++i)
+                it = c.insert(it, make<T>(i));
+            emit("insert_middle", ns_since(start, middle_ops));
+        }
+        {
+            C c = filled<C>(n);
+            auto it = std::next(c.begin(), n / 2);
+            auto start = bench_clock::now();
+            for (size_t i = 0; i != middle_ops; ++i)
+            {
+                it = c.erase(it);
+                if (it == c.end())
+                    it = c.begin();
+            }
+            emit("erase_middle", ns_since(start, middle_ops));
+        }
+        {
+            C c = filled<C>(n);
+            emit("traverse", traverse(c));
+        }
+        compact_ops<C>::run(emit, n);
+        emit("sort", sort_ops<C>::run(n));
+        {
+            C src = filled<C>(n);
+            auto start = bench_clock::now();
+            C copy = src;
+            emit("copy_ctor", ns_since(start, n));
+            sink = copy.size();
+        }
+        {
+            C src = filled<C>(n);
+            C dst = filled<C>(n / 2);
+            auto start = bench_clock::now();
+            dst = src;
+            emit("assign", ns_since(start, n));
+        }
+        emit("splice", splice_ops<C>::run(n, calls));
+        {
+            C a = filled<C>(n);
+            C b = filled<C>(n);
+            auto start = bench_clock::now();
+            for (size_t i = 0; i != calls; ++i)
+                a.swap(b);
+            emit("swap", ns_since(start, calls));
+        }
+        {
+            C c = filled<C>(n);
+            auto start = bench_clock::now();
+            c.clear();
+            emit("clear", ns_since(start, n));
+        }
+        {
+            C src = filled<C>(n);
+            C c = src;
+            auto start = bench_clock::now();
+            c.clear();
+            emit("clear_copy", ns_since(start, n));
+        }
+    }
+
+    template <typename T>
+    void run_type(reporter& report, char const* type, size_t n)
+    {
+        run_cases<list<T>>(report, "list", type, n);
+        run_cases<list<T, pool_allocator<T>>>(report, "list+pool", type, n);
+        run_cases<unrolled_list<T, 32>>(report, "unrolled_list", type, n);
+        run_cases<std::list<T>>(report, "std::list", type, n);
+        run_cases<std::deque<T>>(report, "std::deque", type, n);
+        run_cases<std::vector<T>>(report, "std::vector", type, n);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    size_t max_n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+
+    reporter report;
+    std::printf("{\"unit\": \"ns\", \"results\": [");
+    for (size_t n = 10; n <= max_n; n *= 10)
+    {
+        run_type<int>(report, "int", n);
+        run_type<pod64>(report, "pod64", n);
+        run_type<std::string>(report, "string", n);
+        std::fflush(stdout);
+    }
+    std::printf("\n]}\n");
+    return 0;
+}
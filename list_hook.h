@@ -0,0 +1,40 @@
+#pragma once
+
+// Pair of links shared by the nodes of list and the hooks of intrusive_list.
+// A hook that is not on any list points to itself; copying an object never
+// copies its links, so a copy starts out unlinked.
+struct list_hook
+{
+    list_hook *left;
+    list_hook *right;
+
+    list_hook(list_hook *left, list_hook *right) noexcept : left(left), right(right) {}
+    list_hook() noexcept : left(this), right(this) {}
+
+    list_hook(list_hook const&) noexcept : list_hook() {}
+    list_hook& operator=(list_hook const&) noexcept {
+        return *this;
+    }
+
+    bool is_linked() const noexcept {
+        return left != this;
+    }
+
+    void unlink() noexcept {
+        left->right = right;
+        right->left = left;
+        left = right = this;
+    }
+};
+
+// Hook that removes its owner from whatever list it is on when destroyed.
+struct auto_unlink_hook : list_hook
+{
+    auto_unlink_hook() = default;
+    auto_unlink_hook(auto_unlink_hook const&) = default;
+    auto_unlink_hook& operator=(auto_unlink_hook const&) = default;
+
+    ~auto_unlink_hook() {
+        unlink();
+    }
+};
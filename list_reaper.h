@@ -0,0 +1,46 @@
+#pragma once
+
+#include "list.h"
+#include "reaper.h"
+
+// Empties the list in O(1) and leaves destroying the elements and freeing the
+// nodes to the reaper thread, which may wait while the reaper is over its limit.
+// Nodes are freed through a default-constructed allocator, so the allocator
+// must be always equal.
+template <typename T, typename Alloc>
+void clear_deferred(list<T, Alloc>& c, reaper& r) {
+    using node = typename list<T, Alloc>::node;
+    static_assert(list<T, Alloc>::node_traits::is_always_equal::value, "nodes are freed away from the list");
+    if (c.count == 0) {
+        return;
+    }
+    node* head = c.fake.right;
+    c.fake.left->right = nullptr;
+    try {
+        r.submit(head, c.count, &list<T, Alloc>::reap_chain);
+    } catch (...) {
+        c.fake.left->right = &c.fake;
+        throw;
+    }
+    c.fake.right = c.fake.left = &c.fake;
+    c.count = 0;
+}
+
+template <typename T, typename Alloc>
+void clear_deferred(list<T, Alloc>& c) {
+    clear_deferred(c, reaper::shared());
+}
+
+// Runs on the reaper thread, so it cannot use the list's spare cache.
+template <typename T, typename Alloc>
+void list<T, Alloc>::reap_chain(void* head, size_t) {
+    node_allocator alloc;
+    node* cur = static_cast<node*>(head);
+    while (cur) {
+        fullnode* p = static_cast<fullnode*>(cur);
+        cur = cur->right;
+        block_header* block = p->block;
+        p->~fullnode();
+        return_storage(alloc, p, block);
+    }
+}
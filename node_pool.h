@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// Slab allocator for fixed-size nodes. Storage is carved out of slabs of
+// geometrically growing size and freed blocks are recycled through an
+// intrusive free list, so the global allocator is only hit for new slabs.
+//
+// The block size is fixed by the first single-object allocation; requests of
+// any other size bypass the pool. Arrays bypass it too: blocks are reused one
+// at a time, so arrays carved from the slabs would make the pool grow for good.
+//
+// reset() takes back every block at once in O(slabs): the slabs are kept and
+// handed out again before a new one is allocated.
+struct node_pool
+{
+    node_pool() = default;
+    node_pool(node_pool const&) = delete;
+    node_pool& operator=(node_pool const&) = delete;
+    ~node_pool();
+
+    bool serves(size_t size) noexcept;
+    void* allocate();
+    void deallocate(void* p) noexcept;
+    void reset() noexcept;
+
+    size_t live_blocks() const noexcept
+    {
+        return live;
+    }
+
+private:
+    struct free_node
+    {
+        free_node* next;
+    };
+
+    struct slab
+    {
+        slab* next;
+        size_t blocks;
+    };
+
+    static constexpr size_t first_slab_blocks = 8;
+    static constexpr size_t max_slab_blocks = 1024;
+    static constexpr size_t granularity = alignof(std::max_align_t);
+    static constexpr size_t header_size = (sizeof(slab) + granularity - 1) / granularity * granularity;
+
+    void add_slab();
+    void use_slab(slab* s) noexcept;
+
+    size_t block_size = 0;
+    size_t object_size = 0;
+    slab* slabs = nullptr;
+    free_node* free_head = nullptr;
+    char* bump = nullptr;
+    char* bump_end = nullptr;
+    size_t next_slab_blocks = first_slab_blocks;
+    // Slabs emptied by reset() that the bump pointer has not reached yet.
+    slab* reuse = nullptr;
+    size_t live = 0;
+};
+
+inline node_pool::~node_pool()
+{
+    while (slabs) {
+        slab* s = slabs;
+        slabs = s->next;
+        ::operator delete(s);
+    }
+}
+
+inline bool node_pool::serves(size_t size) noexcept
+{
+    if (object_size == 0) {
+        object_size = size;
+        block_size = (std::max(size, sizeof(free_node)) + granularity - 1) / granularity * granularity;
+    }
+    return size == object_size;
+}
+
+inline void* node_pool::allocate()
+{
+    if (free_head) {
+        free_node* n = free_head;
+        free_head = n->next;
+        ++live;
+        return n;
+    }
+    if (bump == bump_end) {
+        if (reuse) {
+            use_slab(reuse);
+            reuse = reuse->next;
+        } else {
+            add_slab();
+        }
+    }
+    void* p = bump;
+    bump += block_size;
+    ++live;
+    return p;
+}
+
+inline void node_pool::deallocate(void* p) noexcept
+{
+    auto* n = static_cast<free_node*>(p);
+    n->next = free_head;
+    free_head = n;
+    --live;
+}
+
+inline void node_pool::reset() noexcept
+{
+    free_head = nullptr;
+    live = 0;
+    if (slabs) {
+        use_slab(slabs);
+        reuse = slabs->next;
+    }
+}
+
+inline void node_pool::use_slab(slab* s) noexcept
+{
+    bump = reinterpret_cast<char*>(s) + header_size;
+    bump_end = bump + s->blocks * block_size;
+}
+
+inline void node_pool::add_slab()
+{
+    void* mem = ::operator new(header_size + next_slab_blocks * block_size);
+    auto* s = static_cast<slab*>(mem);
+    s->next = slabs;
+    s->blocks = next_slab_blocks;
+    slabs = s;
+
+    use_slab(s);
+    if (next_slab_blocks < max_slab_blocks) {
+        next_slab_blocks *= 2;
+    }
+}
+
+// Allocator handing out single objects from a node_pool. Copies and rebinds
+// share the pool; a container copy gets a fresh one, so every list owns its
+// own pool. Nodes can only be spliced between lists sharing a pool.
+template <typename T>
+struct pool_allocator
+{
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    pool_allocator() : pool(std::make_shared<node_pool>()) {}
+
+    // Declared so that moves copy: a moved-from allocator must still own the pool.
+    pool_allocator(pool_allocator const& other) noexcept = default;
+    pool_allocator& operator=(pool_allocator const& other) noexcept = default;
+
+    template <typename U>
+    pool_allocator(pool_allocator<U> const& other) noexcept : pool(other.pool) {}
+
+    pool_allocator select_on_container_copy_construction() const {
+        return pool_allocator();
+    }
+
+    T* allocate(size_t n) {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "over-aligned types are not supported");
+        if (n == 1 && pool->serves(sizeof(T))) {
+            return static_cast<T*>(pool->allocate());
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (n == 1 && pool->serves(sizeof(T))) {
+            pool->deallocate(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    // Single objects currently handed out by the pool, through any copy.
+    size_t allocated() const noexcept {
+        return pool->live_blocks();
+    }
+
+    // Takes back every single object handed out by the pool, through any copy,
+    // without running destructors.
+    void deallocate_all() noexcept {
+        pool->reset();
+    }
+
+    template <typename U>
+    bool operator==(pool_allocator<U> const& other) const noexcept {
+        return pool == other.pool;
+    }
+
+    template <typename U>
+    bool operator!=(pool_allocator<U> const& other) const noexcept {
+        return pool != other.pool;
+    }
+
+private:
+    template <typename U>
+    friend struct pool_allocator;
+
+    std::shared_ptr<node_pool> pool;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Background thread destroying garbage handed to it, such as the nodes of a
+// list emptied by clear_deferred(). Each piece of garbage comes with the number
+// of objects it holds and the function that destroys them. While more than the
+// limit is outstanding, submit() waits for the thread to catch up, which bounds
+// the memory held by the queue.
+//
+// drain() waits until everything submitted so far is destroyed. The destructor
+// drains and stops the thread, so the shared() instance is drained at exit.
+// Destroy functions run on the reaper thread and must not submit to it.
+struct reaper
+{
+    using destroy_fn = void (*)(void* garbage, size_t objects);
+
+    static constexpr size_t default_limit = size_t(1) << 24;
+
+    explicit reaper(size_t limit = default_limit);
+    reaper(reaper const&) = delete;
+    reaper& operator=(reaper const&) = delete;
+    ~reaper();
+
+    void submit(void* garbage, size_t objects, destroy_fn destroy);
+    void drain();
+
+    // Objects submitted and not destroyed yet.
+    size_t outstanding() const;
+    size_t limit() const noexcept
+    {
+        return max_outstanding;
+    }
+
+    static reaper& shared();
+
+private:
+    struct job
+    {
+        void* garbage;
+        size_t objects;
+        destroy_fn destroy;
+    };
+
+    void run();
+
+    size_t const max_outstanding;
+    size_t pending = 0;
+    bool stopping = false;
+    std::deque<job> queue;
+    mutable std::mutex m;
+    // Signalled when a job is queued or the thread has to stop.
+    std::condition_variable work;
+    // Signalled when a job has been destroyed.
+    std::condition_variable done;
+    // Last, so that the thread starts once everything else is initialised.
+    std::thread worker;
+};
+
+inline reaper::reaper(size_t limit) : max_outstanding(limit), worker(&reaper::run, this) {}
+
+inline reaper::~reaper()
+{
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    work.notify_one();
+    worker.join();
+}
+
+// A single piece larger than the limit is still accepted once the queue is empty.
+inline void reaper::submit(void* garbage, size_t objects, destroy_fn destroy)
+{
+    std::unique_lock<std::mutex> lock(m);
+    done.wait(lock, [&] { return pending == 0 || pending + objects <= max_outstanding; });
+    queue.push_back(job{garbage, objects, destroy});
+    pending += objects;
+    lock.unlock();
+    work.notify_one();
+}
+
+inline void reaper::drain()
+{
+    std::unique_lock<std::mutex> lock(m);
+    done.wait(lock, [&] { return pending == 0; });
+}
+
+inline size_t reaper::outstanding() const
+{
+    std::lock_guard<std::mutex> lock(m);
+    return pending;
+}
+
+inline reaper& reaper::shared()
+{
+    static reaper instance;
+    return instance;
+}
+
+inline void reaper::run()
+{
+    std::unique_lock<std::mutex> lock(m);
+    for (;;) {
+        work.wait(lock, [&] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        job j = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        j.destroy(j.garbage, j.objects);
+        lock.lock();
+        pending -= j.objects;
+        done.notify_all();
+    }
+}
@@ -1,6 +1,10 @@
 #define _GLIBCXX_DEBUG 1
 #include "counted.h"
 #include "list.h"
+#include "list_reaper.h"
+#include "node_pool.h"
+#include "unrolled_list.h"
+#include "intrusive_list.h"
 using container = list<counted>;
 
 #include "tests.inl"
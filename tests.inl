@@ -1,5 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "fault_injection.h"
 
 template <typename T>
@@ -55,6 +62,8 @@ void expect_reverse_eq(C const& c, std::initializer_list<T> elems)
 
 static_assert(!std::is_constructible<container::iterator, std::nullptr_t>::value, "iterator should not be constructible from nullptr");
 static_assert(!std::is_constructible<container::const_iterator, std::nullptr_t>::value, "const_iterator should not be constructible from nullptr");
+static_assert(std::is_nothrow_move_constructible<container>::value, "move constructor should be noexcept");
+static_assert(std::is_nothrow_move_assignable<container>::value, "move assignment should be noexcept");
 
 TEST(correctness, default_ctor)
 {
@@ -253,6 +262,59 @@ TEST(correctness, assignment_operator)
     expect_eq(c2, {1, 2, 3, 4});
 }
 
+TEST(correctness, assignment_reuses_nodes)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 3, 4});
+    container c2;
+    mass_push_back(c2, {5, 6});
+    container::iterator i = c2.begin();
+    c2 = c;
+    expect_eq(c2, {1, 2, 3, 4});
+    EXPECT_EQ(c2.begin(), i);
+    EXPECT_EQ(1, *i);
+    c.pop_back();
+    c.pop_back();
+    c.pop_back();
+    c2 = c;
+    expect_eq(c2, {1});
+    expect_reverse_eq(c2, {1});
+    EXPECT_EQ(1u, c2.size());
+    EXPECT_EQ(c2.begin(), i);
+}
+
+TEST(correctness, assign_strong)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 3});
+    container c2;
+    mass_push_back(c2, {4});
+    c2.assign_strong(c);
+    expect_eq(c2, {1, 2, 3});
+    c2.assign_strong(c2);
+    expect_eq(c2, {1, 2, 3});
+}
+
+TEST(correctness, erase_range)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 3, 4, 5});
+    auto i = c.erase(std::next(c.begin()), std::prev(c.end()));
+    EXPECT_EQ(5, *i);
+    expect_eq(c, {1, 5});
+    EXPECT_EQ(2u, c.size());
+    i = c.erase(c.begin(), c.begin());
+    EXPECT_EQ(1, *i);
+    c.erase(c.begin(), c.end());
+    EXPECT_TRUE(c.empty());
+}
+
 TEST(correctness, self_assignment)
 {
     counted::no_new_instances_guard g;
@@ -263,6 +325,92 @@ TEST(correctness, self_assignment)
     expect_eq(c, {1, 2, 3, 4});
 }
 
+TEST(correctness, move_ctor)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 3, 4});
+    container::iterator i = std::next(c.begin());
+    container c2 = std::move(c);
+    EXPECT_TRUE(c.empty());
+    expect_eq(c2, {1, 2, 3, 4});
+    EXPECT_EQ(2, *i);
+    EXPECT_EQ(std::next(c2.begin()), i);
+}
+
+TEST(correctness, move_assignment)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 3, 4});
+    container c2;
+    mass_push_back(c2, {5, 6, 7, 8});
+    container::iterator i = c.begin();
+    c2 = std::move(c);
+    expect_eq(c2, {1, 2, 3, 4});
+    EXPECT_EQ(c2.begin(), i);
+    c.push_back(9);
+    expect_eq(c, {9});
+}
+
+TEST(correctness, move_self_assignment)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 3, 4});
+    container& r = c;
+    c = std::move(r);
+    expect_eq(c, {1, 2, 3, 4});
+}
+
+TEST(correctness, push_rvalue)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    counted a = 2, b = 3, d = 4;
+    c.push_back(std::move(a));
+    c.push_front(std::move(b));
+    c.insert(std::next(c.begin()), std::move(d));
+    expect_eq(c, {3, 4, 2});
+}
+
+TEST(correctness, emplace)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    EXPECT_EQ(2, c.emplace_back(2));
+    EXPECT_EQ(1, c.emplace_front(1));
+    container::iterator i = c.emplace(std::next(c.begin()), 3);
+    EXPECT_EQ(3, *i);
+    c.emplace(c.end(), 4);
+    expect_eq(c, {1, 3, 2, 4});
+}
+
+struct non_movable
+{
+    non_movable(int a, int b) : sum(a + b) {}
+    non_movable(non_movable const&) = delete;
+    non_movable& operator=(non_movable const&) = delete;
+
+    int sum;
+};
+
+TEST(correctness, emplace_non_movable)
+{
+    list<non_movable> c;
+    c.emplace_back(1, 2);
+    c.emplace_front(3, 4);
+    c.emplace(std::next(c.begin()), 5, 6);
+    EXPECT_EQ(7, c.front().sum);
+    EXPECT_EQ(11, std::next(c.begin())->sum);
+    EXPECT_EQ(3, c.back().sum);
+}
+
 TEST(correctness, pop_back)
 {
     counted::no_new_instances_guard g;
@@ -792,6 +940,76 @@ TEST(correctness, splice_empty_whole)
     EXPECT_TRUE(c2.empty());
 }
 
+TEST(correctness, splice_donor_destroyed_first)
+{
+    counted::no_new_instances_guard g;
+
+    container c1;
+    {
+        container c2, c3;
+        mass_push_back(c2, {5, 6, 7, 8});
+        mass_push_back(c3, {9, 10});
+        c1.splice(c1.end(), c2, std::next(c2.begin()), std::prev(c2.end()));
+        c3.splice(c3.begin(), c2, c2.begin(), c2.end());
+        expect_eq(c3, {5, 8, 9, 10});
+    }
+    expect_eq(c1, {6, 7});
+    c1.pop_front();
+    c1.push_back(11);
+    expect_eq(c1, {7, 11});
+}
+
+TEST(correctness, size)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    EXPECT_EQ(0u, c.size());
+    mass_push_back(c, {1, 2, 3});
+    mass_push_front(c, {4, 5});
+    EXPECT_EQ(5u, c.size());
+    c.insert(c.begin(), 6);
+    c.erase(std::next(c.begin(), 2));
+    c.pop_back();
+    c.pop_front();
+    EXPECT_EQ(3u, c.size());
+    container c2 = c;
+    EXPECT_EQ(3u, c2.size());
+    container c3;
+    mass_push_back(c3, {7});
+    swap(c2, c3);
+    EXPECT_EQ(1u, c2.size());
+    EXPECT_EQ(3u, c3.size());
+    c3 = c2;
+    EXPECT_EQ(1u, c3.size());
+    c.clear();
+    EXPECT_EQ(0u, c.size());
+}
+
+TEST(correctness, splice_size)
+{
+    counted::no_new_instances_guard g;
+
+    container c1, c2;
+    mass_push_back(c1, {1, 2, 3, 4});
+    mass_push_back(c2, {5, 6, 7, 8});
+    c1.splice(c1.begin(), c2, std::next(c2.begin()), std::prev(c2.end()));
+    EXPECT_EQ(6u, c1.size());
+    EXPECT_EQ(2u, c2.size());
+    c2.splice(c2.end(), c1, c1.begin(), std::next(c1.begin(), 3), 3);
+    EXPECT_EQ(3u, c1.size());
+    EXPECT_EQ(5u, c2.size());
+    expect_eq(c2, {5, 8, 6, 7, 1});
+    c1.splice(c1.end(), c1, c1.begin(), std::next(c1.begin()));
+    EXPECT_EQ(3u, c1.size());
+    expect_eq(c1, {3, 4, 2});
+    c1.splice(std::next(c1.begin()), c2);
+    EXPECT_EQ(8u, c1.size());
+    EXPECT_TRUE(c2.empty());
+    EXPECT_EQ(0u, c2.size());
+    expect_eq(c1, {3, 5, 8, 6, 7, 1, 4, 2});
+}
+
 TEST(correctness, splice_self)
 {
     counted::no_new_instances_guard g;
@@ -838,6 +1056,170 @@ TEST(correctness, swap)
     expect_eq(c2, {1, 2, 3, 4});
 }
 
+TEST(correctness, sort)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {5, 3, 8, 1, 9, 2, 7, 4, 6});
+    container::iterator i = c.begin();
+    c.sort();
+    expect_eq(c, {1, 2, 3, 4, 5, 6, 7, 8, 9});
+    expect_reverse_eq(c, {9, 8, 7, 6, 5, 4, 3, 2, 1});
+    EXPECT_EQ(5, *i);
+    EXPECT_EQ(9u, c.size());
+}
+
+TEST(correctness, sort_empty)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    c.sort();
+    EXPECT_TRUE(c.empty());
+    mass_push_back(c, {1});
+    c.sort();
+    expect_eq(c, {1});
+}
+
+TEST(correctness, sort_stable)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {31, 12, 33, 24, 11, 32, 22, 13, 21, 34});
+    c.sort([](int a, int b) { return a / 10 < b / 10; });
+    expect_eq(c, {12, 11, 13, 24, 22, 21, 31, 33, 32, 34});
+}
+
+TEST(correctness, sort_comparator)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {5, 3, 8, 1, 9, 2, 7});
+    c.sort(std::greater<int>());
+    expect_eq(c, {9, 8, 7, 5, 3, 2, 1});
+}
+
+TEST(correctness, remove)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 1, 3, 1, 1, 4});
+    EXPECT_EQ(4u, c.remove(1));
+    expect_eq(c, {2, 3, 4});
+    expect_reverse_eq(c, {4, 3, 2});
+    EXPECT_EQ(3u, c.size());
+    EXPECT_EQ(0u, c.remove(5));
+}
+
+TEST(correctness, remove_element_of_list)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 1, 3, 1});
+    EXPECT_EQ(3u, c.remove(c.front()));
+    expect_eq(c, {2, 3});
+}
+
+TEST(correctness, remove_if)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 2, 3, 4, 5, 6, 7, 8});
+    EXPECT_EQ(4u, c.remove_if([](int x) { return x % 2 == 0; }));
+    expect_eq(c, {1, 3, 5, 7});
+    EXPECT_EQ(4u, c.remove_if([](int) { return true; }));
+    EXPECT_TRUE(c.empty());
+    EXPECT_EQ(0u, c.size());
+}
+
+TEST(correctness, unique)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {1, 1, 2, 3, 3, 3, 1, 4, 4});
+    EXPECT_EQ(4u, c.unique());
+    expect_eq(c, {1, 2, 3, 1, 4});
+    expect_reverse_eq(c, {4, 1, 3, 2, 1});
+    EXPECT_EQ(5u, c.size());
+}
+
+TEST(correctness, unique_predicate)
+{
+    counted::no_new_instances_guard g;
+
+    container c;
+    mass_push_back(c, {10, 11, 19, 20, 35, 31, 42});
+    EXPECT_EQ(3u, c.unique([](int a, int b) { return a / 10 == b / 10; }));
+    expect_eq(c, {10, 20, 35, 42});
+}
+
+TEST(correctness, merge)
+{
+    counted::no_new_instances_guard g;
+
+    container c1, c2;
+    mass_push_back(c1, {1, 3, 5, 7, 9});
+    mass_push_back(c2, {0, 2, 3, 4, 10, 11});
+    container::iterator i = c2.begin();
+    c1.merge(c2);
+    expect_eq(c1, {0, 1, 2, 3, 3, 4, 5, 7, 9, 10, 11});
+    expect_reverse_eq(c1, {11, 10, 9, 7, 5, 4, 3, 3, 2, 1, 0});
+    EXPECT_TRUE(c2.empty());
+    EXPECT_EQ(11u, c1.size());
+    EXPECT_EQ(0u, c2.size());
+    EXPECT_EQ(c1.begin(), i);
+}
+
+TEST(correctness, merge_empty)
+{
+    counted::no_new_instances_guard g;
+
+    container c1, c2;
+    c1.merge(c2);
+    EXPECT_TRUE(c1.empty());
+    mass_push_back(c2, {1, 2});
+    c1.merge(c2);
+    expect_eq(c1, {1, 2});
+    c1.merge(c2);
+    expect_eq(c1, {1, 2});
+    c1.merge(c1);
+    expect_eq(c1, {1, 2});
+}
+
+TEST(correctness, merge_stable)
+{
+    counted::no_new_instances_guard g;
+
+    container c1, c2;
+    mass_push_back(c1, {11, 21, 31});
+    mass_push_back(c2, {12, 22, 23, 32});
+    c1.merge(c2, [](int a, int b) { return a / 10 < b / 10; });
+    expect_eq(c1, {11, 12, 21, 22, 23, 31, 32});
+}
+
+TEST(correctness, merge_all)
+{
+    counted::no_new_instances_guard g;
+
+    container dest;
+    mass_push_back(dest, {10, 40});
+    std::vector<container> runs(3);
+    mass_push_back(runs[0], {11, 20, 41});
+    mass_push_back(runs[2], {12, 30, 42, 50});
+    merge_all(dest, runs.begin(), runs.end(), [](int a, int b) { return a / 10 < b / 10; });
+    expect_eq(dest, {10, 11, 12, 20, 30, 40, 41, 42, 50});
+    EXPECT_EQ(9u, dest.size());
+    for (container const& r : runs)
+        EXPECT_EQ(0u, r.size());
+}
+
 TEST(correctness, swap_self)
 {
     counted::no_new_instances_guard g;
@@ -903,29 +1285,1435 @@ TEST(correctness, clear)
     expect_eq(c, {5, 6, 7, 8});
 }
 
-TEST(fault_injection, push_back)
+static_assert(sizeof(list<int>) == 3 * sizeof(void*) + sizeof(size_t), "default allocator should take no space");
+
+using pooled_container = list<counted, pool_allocator<counted>>;
+
+TEST(correctness, range_ctors)
 {
-    faulty_run([] {
-        counted::no_new_instances_guard g;
+    counted::no_new_instances_guard g;
+    std::vector<int> v = {1, 2, 3, 4};
+    container c1(v.begin(), v.end());
+    expect_eq(c1, {1, 2, 3, 4});
+    container c2(3, 7);
+    expect_eq(c2, {7, 7, 7});
+    EXPECT_EQ(3u, c2.size());
+    container c3 = {5, 6};
+    expect_eq(c3, {5, 6});
+    expect_reverse_eq(c3, {6, 5});
 
-        container c;
-        mass_push_back(c, {1, 2, 3, 4});
-    });
+    std::istringstream in("8 9 10");
+    container c4{std::istream_iterator<int>(in), std::istream_iterator<int>()};
+    expect_eq(c4, {8, 9, 10});
+    EXPECT_EQ(3u, c4.size());
+
+    container c5(v.end(), v.end());
+    EXPECT_TRUE(c5.empty());
 }
 
-TEST(fault_injection, assignment_operator)
+TEST(correctness, range_insert)
 {
-    faulty_run([] {
-        counted::no_new_instances_guard g;
+    counted::no_new_instances_guard g;
+    container c = {1, 5};
+    std::vector<int> v = {2, 3};
+    auto i = c.insert(std::next(c.begin()), v.begin(), v.end());
+    EXPECT_EQ(2, *i);
+    i = c.insert(std::prev(c.end()), 2, 4);
+    EXPECT_EQ(4, *i);
+    i = c.insert(c.end(), {6, 7});
+    EXPECT_EQ(6, *i);
+    i = c.insert(c.begin(), 0, 9);
+    EXPECT_TRUE(i == c.begin());
+    expect_eq(c, {1, 2, 3, 4, 4, 5, 6, 7});
+    expect_reverse_eq(c, {7, 6, 5, 4, 4, 3, 2, 1});
+    EXPECT_EQ(8u, c.size());
+}
 
-        container c;
-        mass_push_back(c, {1, 2, 3, 4});
-        container c2;
-        mass_push_back(c2, {5, 6, 7, 8});
-        c2 = c;
-        expect_eq(c2, {1, 2, 3, 4});
-    });
+TEST(correctness, assign)
+{
+    counted::no_new_instances_guard g;
+    container c = {1, 2, 3};
+    c.assign(2, 9);
+    expect_eq(c, {9, 9});
+    std::vector<int> v = {4, 5, 6, 7};
+    c.assign(v.begin(), v.end());
+    expect_eq(c, {4, 5, 6, 7});
+    c = {8};
+    expect_eq(c, {8});
+    c.assign({});
+    EXPECT_TRUE(c.empty());
+    EXPECT_EQ(0u, c.size());
+}
+
+TEST(allocator, pool_push_pop)
+{
+    counted::no_new_instances_guard g;
+
+    pooled_container c;
+    mass_push_back(c, {1, 2, 3, 4});
+    c.pop_front();
+    c.pop_back();
+    mass_push_front(c, {5, 6});
+    expect_eq(c, {6, 5, 2, 3});
+}
+
+TEST(allocator, pool_copy_ctor)
+{
+    counted::no_new_instances_guard g;
+
+    pooled_container c;
+    mass_push_back(c, {1, 2, 3, 4});
+    pooled_container c2 = c;
+    EXPECT_TRUE(c.get_allocator() != c2.get_allocator());
+    expect_eq(c2, {1, 2, 3, 4});
+}
+
+TEST(allocator, pool_assignment_keeps_allocator)
+{
+    counted::no_new_instances_guard g;
+
+    pooled_container c, c2;
+    mass_push_back(c, {1, 2, 3, 4});
+    mass_push_back(c2, {5, 6});
+    pool_allocator<counted> a = c2.get_allocator();
+    c2 = c;
+    EXPECT_TRUE(c2.get_allocator() == a);
+    expect_eq(c2, {1, 2, 3, 4});
+}
+
+TEST(allocator, pool_swap_propagates)
+{
+    counted::no_new_instances_guard g;
+
+    pooled_container c, c2;
+    mass_push_back(c, {1, 2, 3, 4});
+    pool_allocator<counted> a = c.get_allocator();
+    swap(c, c2);
+    EXPECT_TRUE(c2.get_allocator() == a);
+    EXPECT_TRUE(c.empty());
+    expect_eq(c2, {1, 2, 3, 4});
 }
+
+TEST(allocator, pool_splice_shared)
+{
+    counted::no_new_instances_guard g;
+
+    pooled_container c1;
+    mass_push_back(c1, {1, 2, 3, 4});
+    {
+        pooled_container c2(c1.get_allocator());
+        mass_push_back(c2, {5, 6, 7, 8});
+        c1.splice(std::next(c1.begin()), c2, c2.begin(), std::next(c2.begin(), 2));
+    }
+    expect_eq(c1, {1, 5, 6, 2, 3, 4});
+}
+
+TEST(allocator, pool_bulk_reuse)
+{
+    std::vector<int> v(100, 1);
+    list<int, pool_allocator<int>> c;
+    auto bulk_ops = [&] {
+        c.assign(v.begin(), v.end());
+        c.insert(c.begin(), 50, 2);
+        list<int, pool_allocator<int>> c2(c.get_allocator());
+        c2.insert(c2.end(), v.begin(), v.end());
+        list<int, pool_allocator<int>> c3(c2, c.get_allocator());
+        c3.reserve(200);
+    };
+    bulk_ops();
+    allocation_probe p;
+    for (int i = 0; i != 10; ++i)
+        bulk_ops();
+    EXPECT_EQ(0u, p.allocations());
+}
+
+TEST(allocator, pool_repeated_assign)
+{
+    std::vector<int> v(1000, 1);
+    list<int, pool_allocator<int>> c(v.begin(), v.end());
+    allocation_probe p;
+    for (int i = 0; i != 200; ++i)
+        c.assign(v.begin(), v.end());
+    EXPECT_EQ(1000u, c.get_allocator().allocated());
+    // Whatever the pool needs beyond the first fill is allocated once, not per assign.
+    EXPECT_LT(p.bytes(), 200000u);
+
+    // The first single object sets the block size, so arrays of int would fit.
+    pool_allocator<int> a;
+    a.allocate(1);
+    std::ptrdiff_t live = p.live_bytes();
+    for (int i = 0; i != 100; ++i)
+        a.deallocate(a.allocate(1000), 1000);
+    EXPECT_EQ(live, p.live_bytes());
+    EXPECT_EQ(1u, a.allocated());
+    a.deallocate_all();
+}
+
+using unrolled_container = unrolled_list<counted, 4>;
+
+TEST(unrolled_list, push_pop)
+{
+    counted::no_new_instances_guard g;
+
+    unrolled_container c;
+    mass_push_back(c, {5, 6, 7, 8, 9, 10});
+    mass_push_front(c, {4, 3, 2, 1});
+    expect_eq(c, {1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+    expect_reverse_eq(c, {10, 9, 8, 7, 6, 5, 4, 3, 2, 1});
+    EXPECT_EQ(10u, c.size());
+    EXPECT_EQ(1, c.front());
+    EXPECT_EQ(10, c.back());
+    c.pop_front();
+    c.pop_back();
+    expect_eq(c, {2, 3, 4, 5, 6, 7, 8, 9});
+    while (!c.empty())
+        c.pop_back();
+    EXPECT_EQ(c.begin(), c.end());
+}
+
+TEST(unrolled_list, insert_erase)
+{
+    counted::no_new_instances_guard g;
+
+    unrolled_container c;
+    mass_push_back(c, {1, 2, 3, 4, 5, 6, 7, 8});
+    unrolled_container::iterator i = c.insert(std::next(c.begin(), 3), 42);
+    EXPECT_EQ(42, *i);
+    expect_eq(c, {1, 2, 3, 42, 4, 5, 6, 7, 8});
+    i = c.erase(std::next(c.begin(), 4));
+    EXPECT_EQ(5, *i);
+    i = c.erase(i);
+    EXPECT_EQ(6, *i);
+    i = c.erase(std::prev(c.end()));
+    EXPECT_EQ(c.end(), i);
+    expect_eq(c, {1, 2, 3, 42, 6, 7});
+    expect_reverse_eq(c, {7, 6, 42, 3, 2, 1});
+    EXPECT_EQ(6u, c.size());
+}
+
+TEST(unrolled_list, random_ops)
+{
+    counted::no_new_instances_guard g;
+
+    std::mt19937 gen(1);
+    unrolled_container c;
+    std::vector<int> expected;
+    for (int step = 0; step != 2000; ++step)
+    {
+        size_t pos = expected.empty() ? 0 : gen() % (expected.size() + 1);
+        if (gen() % 3 != 0 || expected.empty())
+        {
+            c.insert(std::next(c.begin(), pos), step);
+            expected.insert(expected.begin() + pos, step);
+        }
+        else
+        {
+            pos %= expected.size();
+            c.erase(std::next(c.begin(), pos));
+            expected.erase(expected.begin() + pos);
+        }
+    }
+    EXPECT_EQ(expected.size(), c.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), c.begin(), c.end()));
+    EXPECT_TRUE(std::equal(expected.rbegin(), expected.rend(), c.rbegin(), c.rend()));
+}
+
+TEST(unrolled_list, splice)
+{
+    counted::no_new_instances_guard g;
+
+    unrolled_container c1, c2;
+    mass_push_back(c1, {1, 2, 3, 4, 5, 6, 7, 8, 9});
+    mass_push_back(c2, {10, 11, 12, 13, 14, 15, 16, 17, 18});
+    c1.splice(std::next(c1.begin(), 3), c2, std::next(c2.begin(), 2), std::next(c2.begin(), 7));
+    expect_eq(c1, {1, 2, 3, 12, 13, 14, 15, 16, 4, 5, 6, 7, 8, 9});
+    expect_eq(c2, {10, 11, 17, 18});
+    EXPECT_EQ(14u, c1.size());
+    EXPECT_EQ(4u, c2.size());
+    c1.splice(std::next(c1.begin(), 5), c1, std::next(c1.begin()), std::next(c1.begin(), 2));
+    expect_eq(c1, {1, 3, 12, 13, 2, 14, 15, 16, 4, 5, 6, 7, 8, 9});
+    c2.splice(c2.end(), c1);
+    EXPECT_TRUE(c1.empty());
+    expect_eq(c2, {10, 11, 17, 18, 1, 3, 12, 13, 2, 14, 15, 16, 4, 5, 6, 7, 8, 9});
+    expect_reverse_eq(c2, {9, 8, 7, 6, 5, 4, 16, 15, 14, 2, 13, 12, 3, 1, 18, 17, 11, 10});
+    EXPECT_EQ(18u, c2.size());
+}
+
+TEST(unrolled_list, copy_move)
+{
+    counted::no_new_instances_guard g;
+
+    unrolled_container c;
+    mass_push_back(c, {1, 2, 3, 4, 5, 6});
+    unrolled_container c2 = c;
+    expect_eq(c2, {1, 2, 3, 4, 5, 6});
+    unrolled_container c3;
+    mass_push_back(c3, {7, 8});
+    c3 = c2;
+    expect_eq(c3, {1, 2, 3, 4, 5, 6});
+    unrolled_container c4 = std::move(c3);
+    EXPECT_TRUE(c3.empty());
+    expect_eq(c4, {1, 2, 3, 4, 5, 6});
+    c = std::move(c4);
+    expect_eq(c, {1, 2, 3, 4, 5, 6});
+    swap(c, c3);
+    EXPECT_TRUE(c.empty());
+    expect_eq(c3, {1, 2, 3, 4, 5, 6});
+}
+
+struct hooked
+{
+    explicit hooked(int value) : value(value) {}
+
+    int value;
+    list_hook hook;
+};
+
+struct auto_hooked
+{
+    explicit auto_hooked(int value) : value(value) {}
+
+    int value;
+    auto_unlink_hook hook;
+};
+
+using hooked_list = intrusive_list<hooked, &hooked::hook>;
+
+template <typename C>
+std::vector<int> values(C const& c)
+{
+    std::vector<int> result;
+    for (auto const& e : c)
+        result.push_back(e.value);
+    return result;
+}
+
+TEST(intrusive_list, push_erase)
+{
+    hooked a(1), b(2), c(3), d(4);
+    hooked_list l;
+    l.push_back(b);
+    l.push_back(c);
+    l.push_front(a);
+    l.insert(l.end(), d);
+    EXPECT_EQ((std::vector<int>{1, 2, 3, 4}), values(l));
+    EXPECT_EQ(4u, l.size());
+    EXPECT_EQ(&a, &l.front());
+    EXPECT_EQ(&d, &l.back());
+    EXPECT_TRUE(b.hook.is_linked());
+
+    hooked_list::iterator i = l.erase(l.iterator_to(b));
+    EXPECT_EQ(&c, &*i);
+    EXPECT_FALSE(b.hook.is_linked());
+    l.remove(d);
+    l.pop_front();
+    EXPECT_EQ((std::vector<int>{3}), values(l));
+    l.push_back(b);
+    EXPECT_EQ((std::vector<int>{3, 2}), values(l));
+    l.clear();
+    EXPECT_TRUE(l.empty());
+    EXPECT_FALSE(c.hook.is_linked());
+}
+
+TEST(intrusive_list, splice_swap)
+{
+    hooked a(1), b(2), c(3), d(4), e(5);
+    hooked_list l1, l2;
+    l1.push_back(a);
+    l1.push_back(b);
+    l2.push_back(c);
+    l2.push_back(d);
+    l2.push_back(e);
+    l1.splice(std::next(l1.begin()), l2, std::next(l2.begin()), l2.end());
+    EXPECT_EQ((std::vector<int>{1, 4, 5, 2}), values(l1));
+    EXPECT_EQ((std::vector<int>{3}), values(l2));
+    swap(l1, l2);
+    EXPECT_EQ((std::vector<int>{3}), values(l1));
+    EXPECT_EQ((std::vector<int>{1, 4, 5, 2}), values(l2));
+    hooked_list l3 = std::move(l2);
+    EXPECT_TRUE(l2.empty());
+    l3.splice(l3.begin(), l1);
+    EXPECT_EQ((std::vector<int>{3, 1, 4, 5, 2}), values(l3));
+}
+
+TEST(intrusive_list, copy_is_unlinked)
+{
+    hooked a(1);
+    hooked_list l;
+    l.push_back(a);
+    hooked b = a;
+    EXPECT_FALSE(b.hook.is_linked());
+    l.push_back(b);
+    EXPECT_EQ(2u, l.size());
+}
+
+TEST(intrusive_list, auto_unlink)
+{
+    auto_unlink_list<auto_hooked, &auto_hooked::hook> l;
+    auto_hooked a(1);
+    {
+        auto_hooked b(2);
+        l.push_back(a);
+        l.push_back(b);
+        EXPECT_EQ(2u, l.size());
+    }
+    EXPECT_EQ((std::vector<int>{1}), values(l));
+    {
+        auto_unlink_list<auto_hooked, &auto_hooked::hook> l2;
+        auto_hooked c(3);
+        l2.push_back(c);
+        l.splice(l.end(), l2);
+    }
+    EXPECT_EQ((std::vector<int>{1}), values(l));
+}
+
+TEST(fault_injection, push_back)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        mass_push_back(c, {1, 2, 3, 4});
+    });
+}
+
+TEST(fault_injection, assignment_operator)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        mass_push_back(c, {1, 2, 3, 4});
+        container c2;
+        mass_push_back(c2, {5, 6, 7, 8});
+        c2 = c;
+        expect_eq(c2, {1, 2, 3, 4});
+    });
+}
+
+TEST(fault_injection, assign_strong)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        mass_push_back(c, {1, 2, 3, 4});
+        container c2;
+        mass_push_back(c2, {5, 6});
+        try {
+            c2.assign_strong(c);
+        } catch (...) {
+            fault_injection_disable dg;
+            expect_eq(c2, {5, 6});
+            throw;
+        }
+        expect_eq(c2, {1, 2, 3, 4});
+    });
+}
+
+TEST(fault_injection, compact)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        c.reserve(2);
+        mass_push_back(c, {1, 2, 3, 4});
+        c.erase(std::next(c.begin()));
+        try {
+            c.compact();
+        } catch (...) {
+            fault_injection_disable dg;
+            expect_eq(c, {1, 3, 4});
+            throw;
+        }
+        expect_eq(c, {1, 3, 4});
+        EXPECT_EQ(4u, c.capacity());
+    });
+}
+
+TEST(fault_injection, pool_copy_ctor)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        pooled_container c;
+        mass_push_back(c, {1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+        pooled_container c2 = c;
+        expect_eq(c2, {1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+    });
+}
+
+struct throwing_ctor
+{
+    throwing_ctor(int data) : data(data)
+    {
+        fault_injection_point();
+    }
+
+    counted data;
+};
+
+TEST(fault_injection, emplace)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        list<throwing_ctor> c;
+        c.emplace_back(1);
+        c.emplace_front(2);
+        c.emplace(std::next(c.begin()), 3);
+        EXPECT_EQ(2, c.front().data);
+        EXPECT_EQ(1, c.back().data);
+    });
+}
+
+TEST(fault_injection, sort)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        {
+            fault_injection_disable dg;
+            mass_push_back(c, {5, 3, 8, 1, 9, 2, 7, 4, 6});
+        }
+        try {
+            c.sort([](int a, int b) {
+                fault_injection_point();
+                return a < b;
+            });
+        } catch (...) {
+            fault_injection_disable dg;
+            EXPECT_EQ(9u, c.size());
+            EXPECT_EQ(9, std::distance(c.begin(), c.end()));
+            EXPECT_EQ(9, std::distance(c.rbegin(), c.rend()));
+            throw;
+        }
+        expect_eq(c, {1, 2, 3, 4, 5, 6, 7, 8, 9});
+    });
+}
+
+TEST(fault_injection, merge)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c1, c2;
+        {
+            fault_injection_disable dg;
+            mass_push_back(c1, {1, 3, 5, 7});
+            mass_push_back(c2, {2, 3, 4, 8});
+        }
+        try {
+            c1.merge(c2, [](int a, int b) {
+                fault_injection_point();
+                return a < b;
+            });
+        } catch (...) {
+            fault_injection_disable dg;
+            EXPECT_EQ(8u, c1.size() + c2.size());
+            EXPECT_EQ(c1.size(), static_cast<size_t>(std::distance(c1.begin(), c1.end())));
+            EXPECT_EQ(c2.size(), static_cast<size_t>(std::distance(c2.begin(), c2.end())));
+            throw;
+        }
+        expect_eq(c1, {1, 2, 3, 3, 4, 5, 7, 8});
+    });
+}
+
+TEST(fault_injection, remove_if)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        {
+            fault_injection_disable dg;
+            mass_push_back(c, {1, 2, 3, 4, 5, 6});
+        }
+        try {
+            c.remove_if([](int x) {
+                fault_injection_point();
+                return x % 2 == 0;
+            });
+        } catch (...) {
+            fault_injection_disable dg;
+            EXPECT_EQ(c.size(), static_cast<size_t>(std::distance(c.begin(), c.end())));
+            throw;
+        }
+        expect_eq(c, {1, 3, 5});
+    });
+}
+
+TEST(fault_injection, unrolled_list_insert)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        unrolled_container c;
+        mass_push_back(c, {1, 2, 3, 4, 5, 6, 7, 8, 9});
+        c.insert(std::next(c.begin(), 2), 10);
+        c.insert(std::next(c.begin(), 4), 11);
+        c.push_front(12);
+        unrolled_container c2 = c;
+        expect_eq(c2, {12, 1, 2, 10, 3, 11, 4, 5, 6, 7, 8, 9});
+    });
+}
+
+struct throwing_assign
+{
+    throwing_assign(int data) : data(data) {}
+    throwing_assign(throwing_assign const&) = default;
+    throwing_assign& operator=(throwing_assign const& other)
+    {
+        fault_injection_point();
+        data = other.data;
+        return *this;
+    }
+
+    counted data;
+};
+
+TEST(fault_injection, unrolled_list_shift)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        unrolled_list<throwing_assign, 4> c;
+        {
+            fault_injection_disable dg;
+            c.push_back(1);
+            c.push_back(2);
+            c.push_back(3);
+        }
+        try {
+            c.emplace(std::next(c.begin()), 4);
+        } catch (...) {
+            fault_injection_disable dg;
+            EXPECT_EQ(c.size(), static_cast<size_t>(std::distance(c.begin(), c.end())));
+            throw;
+        }
+        EXPECT_EQ(4u, c.size());
+        EXPECT_EQ(4, std::next(c.begin())->data);
+    });
+}
+
+TEST(fault_injection, spare_nodes)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        list<throwing_ctor> c;
+        c.prefill_spare(2);
+        c.emplace_back(1);
+        c.emplace_back(2);
+        c.pop_front();
+        c.emplace_back(3);
+        c.emplace_back(4);
+        EXPECT_EQ(2, c.front().data);
+        EXPECT_EQ(4, c.back().data);
+    });
+}
+
+TEST(fault_injection, reserve)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        list<throwing_ctor> c;
+        c.emplace_back(0);
+        c.reserve(4);
+        c.emplace_back(1);
+        c.emplace_back(2);
+        c.clear();
+        c.emplace_back(3);
+        c.emplace_back(4);
+        c.emplace_back(5);
+        c.emplace_back(6);
+        c.emplace_back(7);
+        EXPECT_EQ(3, c.front().data);
+        EXPECT_EQ(5u, c.size());
+    });
+}
+
+TEST(fault_injection, range_insert)
+{
+    faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        {
+            fault_injection_disable dg;
+            mass_push_back(c, {1, 2});
+        }
+        std::vector<int> v = {3, 4, 5};
+        try {
+            c.insert(std::next(c.begin()), v.begin(), v.end());
+        } catch (...) {
+            fault_injection_disable dg;
+            expect_eq(c, {1, 2});
+            throw;
+        }
+        try {
+            c.assign(2, 6);
+        } catch (...) {
+            fault_injection_disable dg;
+            expect_eq(c, {1, 3, 4, 5, 2});
+            throw;
+        }
+        expect_eq(c, {6, 6});
+    });
+}
+
+TEST(fault_injection, parallel_copy_ctor)
+{
+    parallel_faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        for (int i = 0; i != 100; ++i)
+            c.push_back(i);
+        container c2 = c;
+        EXPECT_EQ(100u, c2.size());
+        EXPECT_EQ(99, c2.back());
+    }, 4);
+}
+
+TEST(fault_injection, parallel_reports_first_failure)
+{
+    // Fails for every schedule that lets the first three points pass; a serial
+    // run stops at {3}, whichever thread finds it.
+    auto f = [] {
+        for (int i = 0; i != 3; ++i)
+            fault_injection_point();
+        throw 3;
+    };
+    for (size_t threads : {1, 2, 5})
+    {
+        try
+        {
+            parallel_faulty_run(f, threads);
+            ADD_FAILURE();
+        }
+        catch (int e)
+        {
+            EXPECT_EQ(3, e);
+        }
+    }
+    EXPECT_THROW(faulty_run(f), int);
+}
+
+TEST(fault_injection, sampled_copy_ctor)
+{
+    sampled_faulty_run([] {
+        counted::no_new_instances_guard g;
+
+        container c;
+        for (int i = 0; i != 1000; ++i)
+            c.push_back(i);
+        container c2 = c;
+        EXPECT_EQ(1000u, c2.size());
+    }, 0.001, 42, 200);
+}
+
+TEST(fault_injection, sampled_time_budget)
+{
+    size_t runs = 0;
+    sampled_faulty_run([&runs] {
+        ++runs;
+        container c;
+        mass_push_back(c, {1, 2, 3});
+    }, 0.5, 1, std::chrono::milliseconds(20));
+    EXPECT_NE(0u, runs);
+}
+
+TEST(fault_injection, sampled_reports_failure)
+{
+    auto f = [] {
+        for (int i = 0; i != 3; ++i)
+            fault_injection_point();
+        throw 3;
+    };
+    EXPECT_THROW(sampled_faulty_run(f, 0.2, 7, 1000), int);
+}
+
+TEST(fault_injection, deep_schedule)
+{
+    sampled_faulty_run([] {
+        for (int i = 0; i != 5000; ++i)
+        {
+            try {
+                fault_injection_point();
+            } catch (...) {
+            }
+        }
+        fault_injection_point();
+    }, 1.0, 0, 3);
+}
+
+TEST(fault_injection, replay)
+{
+    int reached = 0;
+    auto f = [&reached] {
+        for (reached = 0; reached != 5; ++reached)
+            fault_injection_point();
+    };
+    EXPECT_NO_THROW(replay_faulty_run(f, {}));
+    EXPECT_EQ(5, reached);
+    EXPECT_NO_THROW(replay_faulty_run(f, {2}));
+    EXPECT_EQ(2, reached);
+    EXPECT_NO_THROW(replay_faulty_run(f, {7}));
+    EXPECT_EQ(5, reached);
+    reached = -1;
+    EXPECT_THROW(replay_faulty_run(f, {3, 3}), std::invalid_argument);
+    EXPECT_THROW(replay_faulty_run(f, {4, 1}), std::invalid_argument);
+    EXPECT_EQ(-1, reached);
+
+    auto g = [] {
+        for (int i = 0; i != 5; ++i)
+        {
+            try {
+                fault_injection_point();
+            } catch (injected_fault const&) {
+                if (i == 3)
+                    throw;
+            }
+        }
+    };
+    EXPECT_NO_THROW(replay_faulty_run(g, {3}));
+    EXPECT_NO_THROW(replay_faulty_run(g, {}));
+    EXPECT_THROW(replay_faulty_run(g, {1}), std::logic_error);
+}
+
+TEST(allocation_probe, counts)
+{
+    allocation_probe outer;
+    // Called directly: new-expressions whose result is unused may be elided.
+    void* a = ::operator new(sizeof(int));
+    {
+        allocation_probe p;
+        void* b = ::operator new[](100);
+        std::vector<long long> v(1000);
+        EXPECT_EQ(2u, p.allocations());
+        EXPECT_EQ(100u + 1000 * sizeof(long long), p.bytes());
+        EXPECT_EQ(1u, p.histogram(allocation_size_class(100)));
+        EXPECT_EQ(1u, p.histogram(allocation_size_class(1000 * sizeof(long long))));
+        ::operator delete[](b);
+        EXPECT_EQ(1u, p.deallocations());
+        EXPECT_EQ(static_cast<std::ptrdiff_t>(1000 * sizeof(long long)), p.live_bytes());
+        EXPECT_EQ(static_cast<std::ptrdiff_t>(100 + 1000 * sizeof(long long)), p.peak_bytes());
+    }
+    ::operator delete(a);
+    EXPECT_EQ(0, outer.live_bytes());
+    EXPECT_EQ(3u, outer.allocations());
+    EXPECT_EQ(3u, outer.deallocations());
+    EXPECT_EQ(static_cast<std::ptrdiff_t>(sizeof(int) + 100 + 1000 * sizeof(long long)), outer.peak_bytes());
+}
+
+TEST(allocation_probe, size_classes)
+{
+    EXPECT_EQ(0u, allocation_size_class(1));
+    EXPECT_EQ(1u, allocation_size_class(2));
+    EXPECT_EQ(2u, allocation_size_class(3));
+    EXPECT_EQ(2u, allocation_size_class(4));
+    EXPECT_EQ(5u, allocation_size_class(32));
+    EXPECT_EQ(6u, allocation_size_class(33));
+    EXPECT_EQ(allocation_stats::size_classes - 1, allocation_size_class(size_t(1) << 20));
+}
+
+using contract_list = container;
+
+contract_list make_contract_list(std::initializer_list<int> elems)
+{
+    contract_list c;
+    mass_push_back(c, elems);
+    return c;
+}
+
+TEST(performance_contract, push_insert)
+{
+    contract_list c;
+    allocation_probe p;
+    mass_push_back(c, {1, 2, 3});
+    mass_push_front(c, {4, 5});
+    c.insert(std::next(c.begin()), 6);
+    c.emplace(c.end(), 7);
+    c.emplace_back(8);
+    c.emplace_front(9);
+    EXPECT_EQ(9u, p.allocations());
+    EXPECT_EQ(0u, p.deallocations());
+}
+
+TEST(performance_contract, erase_pop_clear)
+{
+    contract_list c = make_contract_list({1, 2, 3, 4, 5, 6, 7, 8});
+    allocation_probe p;
+    c.erase(std::next(c.begin()));
+    c.pop_back();
+    c.pop_front();
+    EXPECT_EQ(3u, p.deallocations());
+    c.clear();
+    EXPECT_EQ(0u, p.allocations());
+    EXPECT_EQ(8u, p.deallocations());
+}
+
+TEST(performance_contract, copy_ctor)
+{
+    contract_list c = make_contract_list({1, 2, 3, 4, 5});
+    allocation_probe p;
+    // Storage for all five nodes is allocated as one block.
+    contract_list c2 = c;
+    EXPECT_EQ(1u, p.allocations());
+    EXPECT_EQ(0u, p.deallocations());
+}
+
+TEST(performance_contract, range_insert)
+{
+    contract_list c = make_contract_list({1, 2});
+    std::vector<int> v = {3, 4, 5, 6};
+    allocation_probe p;
+    c.insert(std::next(c.begin()), v.begin(), v.end());
+    c.insert(c.end(), 3, 7);
+    EXPECT_EQ(2u, p.allocations());
+    EXPECT_EQ(0u, p.deallocations());
+}
+
+TEST(performance_contract, assignment_operator)
+{
+    contract_list c = make_contract_list({1, 2, 3, 4, 5});
+    contract_list c2 = make_contract_list({6, 7, 8});
+    allocation_probe p;
+    c2 = c;
+    EXPECT_EQ(1u, p.allocations());
+    EXPECT_EQ(0u, p.deallocations());
+    c = make_contract_list({9, 10, 11, 12, 13});
+    EXPECT_EQ(6u, p.allocations());
+    EXPECT_EQ(5u, p.deallocations());
+    contract_list c3 = make_contract_list({14});
+    // Two single nodes and the block holding the last two are freed.
+    c2 = c3;
+    EXPECT_EQ(7u, p.allocations());
+    EXPECT_EQ(8u, p.deallocations());
+}
+
+TEST(performance_contract, move)
+{
+    contract_list c = make_contract_list({1, 2, 3, 4, 5});
+    contract_list c2 = make_contract_list({6, 7, 8});
+    allocation_probe p;
+    contract_list c3 = std::move(c);
+    c2 = std::move(c3);
+    EXPECT_EQ(0u, p.allocations());
+    EXPECT_EQ(3u, p.deallocations());
+}
+
+TEST(performance_contract, splice_swap)
+{
+    contract_list c1 = make_contract_list({1, 2, 3, 4});
+    contract_list c2 = make_contract_list({5, 6, 7, 8});
+    allocation_probe p;
+    c1.splice(std::next(c1.begin()), c2, std::next(c2.begin()), std::prev(c2.end()));
+    c1.splice(c1.begin(), c2, c2.begin(), std::next(c2.begin()), 1);
+    c2.splice(c2.end(), c1);
+    c1.splice(c1.end(), c2, c2.begin(), std::next(c2.begin(), 2));
+    swap(c1, c2);
+    c1.swap(c2);
+    EXPECT_EQ(0u, p.allocations());
+    EXPECT_EQ(0u, p.deallocations());
+}
+
+TEST(performance_contract, sort_merge)
+{
+    contract_list c1 = make_contract_list({5, 1, 4, 2, 3});
+    contract_list c2 = make_contract_list({9, 7, 8, 6});
+    allocation_probe p;
+    c1.sort();
+    c2.sort();
+    c1.merge(c2);
+    EXPECT_EQ(0u, p.allocations());
+    EXPECT_EQ(0u, p.deallocations());
+}
+
+TEST(performance_contract, remove_unique)
+{
+    contract_list c = make_contract_list({1, 1, 2, 3, 3, 4, 5, 5});
+    allocation_probe p;
+    c.unique();
+    c.remove_if([](int x) { return x % 2 == 0; });
+    EXPECT_EQ(0u, p.allocations());
+    EXPECT_EQ(5u, p.deallocations());
+}
+
+TEST(spare_nodes, fifo_steady_state)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    c.set_spare_limit(4);
+    mass_push_back(c, {1, 2, 3, 4});
+    c.pop_front();
+    c.push_back(5);
+
+    allocation_probe p;
+    for (int i = 6; i != 1000; ++i)
+    {
+        c.pop_front();
+        c.push_back(i);
+    }
+    EXPECT_EQ(0u, p.allocations());
+    EXPECT_EQ(0u, p.deallocations());
+    expect_eq(c, {996, 997, 998, 999});
+}
+
+TEST(spare_nodes, limit)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    EXPECT_EQ(0u, c.spare_count());
+    mass_push_back(c, {1, 2, 3, 4, 5, 6});
+    c.pop_back();
+    EXPECT_EQ(0u, c.spare_count());
+
+    c.set_spare_limit(3);
+    c.erase(c.begin());
+    EXPECT_EQ(1u, c.spare_count());
+    c.clear();
+    EXPECT_EQ(3u, c.spare_count());
+    c.set_spare_limit(1);
+    EXPECT_EQ(1u, c.spare_count());
+
+    allocation_probe p;
+    c.push_front(7);
+    EXPECT_EQ(0u, p.allocations());
+    EXPECT_EQ(0u, c.spare_count());
+    c.push_front(8);
+    EXPECT_EQ(1u, p.allocations());
+    expect_eq(c, {8, 7});
+}
+
+TEST(spare_nodes, prefill_shrink)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    c.prefill_spare(5);
+    EXPECT_EQ(5u, c.spare_count());
+    {
+        allocation_probe p;
+        mass_push_back(c, {1, 2, 3, 4, 5});
+        EXPECT_EQ(0u, p.allocations());
+    }
+    EXPECT_EQ(0u, c.spare_count());
+    c.clear();
+    EXPECT_EQ(5u, c.spare_count());
+    {
+        allocation_probe p;
+        c.shrink_to_fit();
+        EXPECT_EQ(5u, p.deallocations());
+    }
+    EXPECT_EQ(0u, c.spare_count());
+    c.push_back(1);
+    c.pop_back();
+    EXPECT_EQ(1u, c.spare_count());
+}
+
+TEST(spare_nodes, move_swap)
+{
+    counted::no_new_instances_guard g;
+    container c1;
+    c1.prefill_spare(2);
+    mass_push_back(c1, {1, 2});
+    container c2;
+    mass_push_back(c2, {3});
+    c1.clear();
+    swap(c1, c2);
+    EXPECT_EQ(0u, c1.spare_count());
+    EXPECT_EQ(2u, c2.spare_count());
+    container c3 = std::move(c2);
+    EXPECT_EQ(2u, c3.spare_count());
+    container c4 = c3;
+    EXPECT_EQ(0u, c4.spare_count());
+    c1 = std::move(c3);
+    EXPECT_EQ(2u, c1.spare_count());
+    expect_eq(c1, std::initializer_list<int>{});
+}
+
+TEST(spare_nodes, pooled)
+{
+    counted::no_new_instances_guard g;
+    pooled_container c;
+    c.set_spare_limit(2);
+    mass_push_back(c, {1, 2, 3});
+    c.pop_front();
+    c.pop_front();
+    EXPECT_EQ(2u, c.spare_count());
+    mass_push_back(c, {4, 5});
+    expect_eq(c, {3, 4, 5});
+}
+
+TEST(spare_nodes, reserve)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    c.push_back(0);
+    {
+        allocation_probe p;
+        c.reserve(6);
+        EXPECT_EQ(2u, p.allocations());
+    }
+    EXPECT_EQ(6u, c.capacity());
+    EXPECT_EQ(5u, c.spare_count());
+    {
+        allocation_probe p;
+        mass_push_back(c, {1, 2, 3, 4, 5});
+        EXPECT_EQ(0u, p.allocations());
+    }
+    // The reserved nodes are handed out in address order with a fixed stride.
+    auto address = [&c](size_t i) {
+        return reinterpret_cast<char const*>(&*std::next(c.begin(), i));
+    };
+    EXPECT_LT(0, address(2) - address(1));
+    EXPECT_EQ(address(2) - address(1), address(5) - address(4));
+    c.reserve(4);
+    EXPECT_EQ(6u, c.capacity());
+    c.clear();
+    EXPECT_EQ(6u, c.spare_count());
+    {
+        allocation_probe p;
+        mass_push_back(c, {1, 2, 3, 4, 5, 6});
+        EXPECT_EQ(0u, p.allocations());
+    }
+    expect_eq(c, {1, 2, 3, 4, 5, 6});
+}
+
+TEST(spare_nodes, compact)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    for (int i = 0; i != 10; ++i)
+        c.push_front(i);
+    for (auto i = c.begin(); i != c.end();)
+        i = *i % 3 == 0 ? c.erase(i) : std::next(i);
+    c.set_spare_limit(4);
+    c.pop_back();
+    {
+        allocation_probe p;
+        c.compact();
+        EXPECT_EQ(1u, p.allocations());
+    }
+    expect_eq(c, {8, 7, 5, 4, 2});
+    expect_reverse_eq(c, {2, 4, 5, 7, 8});
+    EXPECT_EQ(1u, c.spare_count());
+    EXPECT_EQ(6u, c.capacity());
+    auto address = [&c](size_t i) {
+        return reinterpret_cast<char const*>(&*std::next(c.begin(), i));
+    };
+    EXPECT_LT(0, address(1) - address(0));
+    EXPECT_EQ(address(1) - address(0), address(4) - address(3));
+
+    c.pop_front();
+    c.push_back(9);
+    expect_eq(c, {7, 5, 4, 2, 9});
+    c.compact();
+    expect_eq(c, {7, 5, 4, 2, 9});
+}
+
+TEST(spare_nodes, compact_reserved)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    c.reserve(10);
+    mass_push_back(c, {1, 2, 3});
+    c.compact();
+    EXPECT_EQ(10u, c.capacity());
+    expect_eq(c, {1, 2, 3});
+    c.clear();
+    EXPECT_EQ(10u, c.spare_count());
+
+    pooled_container c2;
+    mass_push_back(c2, {4, 5});
+    c2.compact();
+    expect_eq(c2, {4, 5});
+}
+
+TEST(spare_nodes, compact_splice)
+{
+    counted::no_new_instances_guard g;
+    container c2;
+    {
+        container c;
+        mass_push_back(c, {1, 2, 3});
+        c.compact();
+        c2.splice(c2.end(), c);
+    }
+    c2.push_back(4);
+    expect_eq(c2, {1, 2, 3, 4});
+    c2.pop_front();
+    c2.compact();
+    expect_eq(c2, {2, 3, 4});
+}
+
+TEST(spare_nodes, reserve_limit)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    c.reserve(3);
+    mass_push_back(c, {1, 2, 3, 4, 5});
+    c.clear();
+    EXPECT_EQ(3u, c.spare_count());
+    {
+        // The block goes with the last of its nodes.
+        allocation_probe p;
+        c.set_spare_limit(0);
+        EXPECT_EQ(0u, c.spare_count());
+        EXPECT_EQ(1u, p.deallocations());
+    }
+    c.push_back(2);
+    expect_eq(c, {2});
+}
+
+TEST(spare_nodes, reserve_splice)
+{
+    counted::no_new_instances_guard g;
+    container c2;
+    {
+        container c;
+        c.reserve(4);
+        mass_push_back(c, {1, 2, 3});
+        c2.splice(c2.end(), c, std::next(c.begin()), c.end());
+        expect_eq(c, {1});
+    }
+    expect_eq(c2, {2, 3});
+    c2.push_back(4);
+    allocation_probe p;
+    c2.clear();
+    EXPECT_EQ(2u, p.deallocations());
+}
+
+TEST(spare_nodes, reserve_merge_all)
+{
+    counted::no_new_instances_guard g;
+    container dest;
+    dest.reserve(6);
+    mass_push_back(dest, {1, 4});
+    std::vector<container> runs(2);
+    mass_push_back(runs[0], {2, 5});
+    mass_push_back(runs[1], {3});
+    merge_all(dest, runs.begin(), runs.end());
+    expect_eq(dest, {1, 2, 3, 4, 5});
+    EXPECT_EQ(4u, dest.spare_count());
+    allocation_probe p;
+    mass_push_back(dest, {6, 7, 8, 9});
+    EXPECT_EQ(0u, p.allocations());
+}
+
+TEST(spare_nodes, reserve_swap_move)
+{
+    counted::no_new_instances_guard g;
+    container c1;
+    c1.reserve(3);
+    mass_push_back(c1, {1, 2});
+    container c2;
+    swap(c1, c2);
+    c2.push_back(3);
+    container c3 = std::move(c2);
+    c3.pop_front();
+    EXPECT_EQ(3u, c3.capacity());
+    expect_eq(c3, {2, 3});
+}
+
+using pooled_ints = list<int, pool_allocator<int>>;
+
+TEST(bulk_release, clear)
+{
+    pooled_ints c;
+    for (int i = 0; i != 1000; ++i)
+        c.push_back(i);
+    EXPECT_EQ(1000u, c.get_allocator().allocated());
+    c.clear();
+    EXPECT_TRUE(c.empty());
+    EXPECT_EQ(0u, c.get_allocator().allocated());
+
+    allocation_probe p;
+    for (int i = 0; i != 1000; ++i)
+        c.push_back(i);
+    EXPECT_EQ(0u, p.allocations());
+    EXPECT_EQ(1000u, c.size());
+    EXPECT_EQ(999, c.back());
+}
+
+TEST(bulk_release, shared_pool)
+{
+    pooled_ints c;
+    pooled_ints c2(c.get_allocator());
+    c.push_back(1);
+    c.push_back(2);
+    c2.push_back(3);
+    c.clear();
+    EXPECT_EQ(1u, c2.get_allocator().allocated());
+    c.push_back(4);
+    EXPECT_EQ(3, c2.front());
+    EXPECT_EQ(4, c.front());
+}
+
+TEST(bulk_release, spare_limit)
+{
+    pooled_ints c;
+    c.set_spare_limit(4);
+    for (int i = 0; i != 3; ++i)
+        c.push_back(i);
+    c.clear();
+    // Nothing was cached: the pool took the nodes back, keeping the limit.
+    EXPECT_EQ(0u, c.spare_count());
+    EXPECT_EQ(1u, c.get_allocator().allocated());
+    for (int i = 0; i != 3; ++i)
+        c.push_back(i);
+    c.pop_back();
+    EXPECT_EQ(1u, c.spare_count());
+    c.clear();
+    EXPECT_EQ(3u, c.spare_count());
+}
+
+TEST(bulk_release, copy)
+{
+    pooled_ints c;
+    for (int i = 0; i != 1000; ++i)
+        c.push_back(i);
+    pooled_ints copy = c;
+    pooled_ints assigned;
+    assigned.assign(c.begin(), c.end());
+    pooled_ints filled(1000, 7);
+    for (pooled_ints* l : {&copy, &assigned, &filled}) {
+        EXPECT_EQ(1000u, l->get_allocator().allocated());
+        l->set_spare_limit(10);
+        l->clear();
+        // Node by node, clear() would have cached 10 nodes.
+        EXPECT_EQ(0u, l->spare_count());
+        EXPECT_EQ(1u, l->get_allocator().allocated());
+    }
+}
+
+// Counts destructions that happen away from the thread running the test.
+struct reaped
+{
+    static std::thread::id owner;
+    static std::atomic<size_t> destroyed_elsewhere;
+
+    ~reaped()
+    {
+        if (std::this_thread::get_id() != owner)
+            ++destroyed_elsewhere;
+    }
+
+    static void reset()
+    {
+        owner = std::this_thread::get_id();
+        destroyed_elsewhere = 0;
+    }
+};
+
+std::thread::id reaped::owner;
+std::atomic<size_t> reaped::destroyed_elsewhere;
+
+TEST(deferred_clear, background)
+{
+    reaped::reset();
+    reaper r;
+    list<reaped> c;
+    for (int i = 0; i != 1000; ++i)
+        c.emplace_back();
+    clear_deferred(c, r);
+    EXPECT_TRUE(c.empty());
+    EXPECT_EQ(0u, c.size());
+    EXPECT_EQ(c.begin(), c.end());
+    c.emplace_back();
+    r.drain();
+    EXPECT_EQ(0u, r.outstanding());
+    EXPECT_EQ(1000u, reaped::destroyed_elsewhere);
+    EXPECT_EQ(1u, c.size());
+}
+
+TEST(deferred_clear, limit)
+{
+    reaped::reset();
+    reaper r(100);
+    for (int k = 0; k != 5; ++k) {
+        list<reaped> c;
+        for (int i = 0; i != 60; ++i)
+            c.emplace_back();
+        clear_deferred(c, r);
+        EXPECT_LE(r.outstanding(), 100u);
+    }
+    r.drain();
+    EXPECT_EQ(300u, reaped::destroyed_elsewhere);
+}
+
+TEST(deferred_clear, reserved)
+{
+    reaped::reset();
+    reaper r;
+    list<reaped> c;
+    c.reserve(4);
+    c.emplace_back();
+    c.emplace_back();
+    clear_deferred(c, r);
+    EXPECT_TRUE(c.empty());
+    EXPECT_EQ(2u, c.spare_count());
+    r.drain();
+    EXPECT_EQ(2u, reaped::destroyed_elsewhere);
+}
+
+TEST(deferred_clear, strings)
+{
+    list<std::string> c;
+    for (int i = 0; i != 1000; ++i)
+        c.push_back(std::string(100, 'x'));
+    clear_deferred(c);
+    c.push_back("y");
+    reaper::shared().drain();
+    expect_eq(c, {std::string("y")});
+}
+
+TEST(counted_registry, many_instances)
+{
+    counted::no_new_instances_guard g;
+    container c;
+    for (int i = 0; i != 100000; ++i)
+        c.push_back(i);
+    for (auto i = c.begin(); i != c.end();)
+        i = c.erase(i);
+    g.expect_no_instances();
+}
+
+TEST(counted_registry, counting_mode)
+{
+    counted::no_new_instances_guard g;
+    container tracked;
+    mass_push_back(tracked, {1, 2, 3});
+    {
+        counted::counting_mode m;
+        container c;
+        for (int i = 0; i != 100000; ++i)
+            c.push_back(i);
+        tracked.splice(tracked.end(), c, c.begin(), std::next(c.begin(), 2));
+        EXPECT_EQ(100000, 2 + static_cast<int>(c.size()));
+    }
+    expect_eq(tracked, {1, 2, 3, 0, 1});
+    tracked.clear();
+}
+
+TEST(counted_registry, guard_does_not_allocate)
+{
+    container c;
+    for (int i = 0; i != 100000; ++i)
+        c.push_back(i);
+
+    allocation_probe p;
+    {
+        counted::no_new_instances_guard g;
+        g.expect_no_instances();
+    }
+    EXPECT_EQ(0u, p.allocations());
+}
+
 /*TEST(invalid, pop_front_empty) {
     EXPECT_EXIT(
     {
@@ -0,0 +1,571 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Doubly linked list of chunks, each holding up to K elements in a fixed array.
+// Iteration walks the array of a chunk before following a pointer, so small
+// payloads are no longer dwarfed by two pointers per element.
+//
+// Unlike list, insert and erase invalidate iterators into the chunks they touch,
+// including chunks that get split or merged. splice first splits the chunks at
+// the ends of the range and at pos, then relinks whole chunks.
+template <typename T, size_t K = 16, typename Alloc = std::allocator<T>>
+struct unrolled_list {
+    static_assert(K >= 2, "chunks must hold at least two elements");
+
+private:
+
+    struct node {
+        node *left;
+        node *right;
+
+        node(node *left, node *right) : left(left), right(right) {};
+        node() : left(this), right(this) {};
+    };
+
+    struct chunk : node {
+        size_t n = 0;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[K];
+
+        chunk(node *left, node *right) : node(left, right) {};
+        T* data() { return reinterpret_cast<T*>(storage); }
+    };
+
+    using chunk_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<chunk>;
+    using chunk_traits = std::allocator_traits<chunk_allocator>;
+
+    static_assert(std::is_same<typename chunk_traits::pointer, chunk*>::value, "fancy pointers are not supported");
+
+    struct sentinel : node, chunk_allocator {
+        sentinel() = default;
+        explicit sentinel(chunk_allocator const& alloc) : node(), chunk_allocator(alloc) {};
+        sentinel(sentinel const&) = delete;
+    };
+
+    template <typename V>
+    struct myiterator : std::iterator<std::bidirectional_iterator_tag, V> {
+        friend struct unrolled_list;
+    public:
+        node* cur;
+        size_t idx;
+
+        myiterator() = default;
+        myiterator(myiterator const& other) : cur(other.cur), idx(other.idx) {};
+        myiterator& operator++() {
+            if (++idx == static_cast<chunk*>(cur)->n) {
+                cur = cur->right;
+                idx = 0;
+            }
+            return *this;
+        }
+
+        operator myiterator<V const>() const noexcept {
+            return myiterator<V const>(cur, idx);
+        }
+
+        const myiterator operator++(int) {
+            myiterator<V> copy(*this);
+            ++*this;
+            return copy;
+        }
+
+        myiterator& operator--() {
+            if (idx == 0) {
+                cur = cur->left;
+                idx = static_cast<chunk*>(cur)->n;
+            }
+            --idx;
+            return *this;
+        }
+
+        const myiterator operator--(int) {
+            myiterator<V> copy(*this);
+            --*this;
+            return copy;
+        }
+        V& operator*() const { return static_cast<chunk*>(cur)->data()[idx]; }
+
+        V* operator->() const { return &static_cast<chunk*>(cur)->data()[idx]; }
+
+        template <typename U>
+        bool operator==(myiterator<U> const& other) const {
+            return cur == other.cur && idx == other.idx;
+        }
+        template <typename U>
+        bool operator!=(myiterator<U> const& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        myiterator(node* n, size_t idx) : cur(n), idx(idx) {};
+    };
+
+    sentinel fake;
+    size_t count = 0;
+
+    chunk_allocator& chunk_alloc() noexcept { return fake; }
+    chunk_allocator const& chunk_alloc() const noexcept { return fake; }
+
+    chunk* create_chunk(node* left, node* right);
+    void destroy_chunk(chunk* c) noexcept;
+    chunk* split(chunk* c, size_t at);
+    bool merge_next(chunk* c) noexcept;
+    void insert_at(chunk* c, size_t i, T&& val);
+    void swap_nodes(unrolled_list& other) noexcept;
+
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using allocator_type = Alloc;
+    using iterator = myiterator<T>;
+    using const_iterator = myiterator<T const>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    unrolled_list();
+    explicit unrolled_list(Alloc const& alloc);
+    unrolled_list(unrolled_list const&);
+    unrolled_list(unrolled_list const&, Alloc const& alloc);
+    unrolled_list(unrolled_list&&) noexcept;
+    unrolled_list& operator=(unrolled_list const&);
+    unrolled_list& operator=(unrolled_list&&) noexcept(chunk_traits::propagate_on_container_move_assignment::value
+                                                       || chunk_traits::is_always_equal::value);
+    ~unrolled_list();
+
+    allocator_type get_allocator() const {
+        return allocator_type(chunk_alloc());
+    }
+
+    void clear();
+    bool empty() const noexcept {
+        return count == 0;
+    }
+    size_type size() const noexcept {
+        return count;
+    }
+
+    void push_back(T const& val) {
+        emplace(end(), val);
+    }
+    void push_back(T&& val) {
+        emplace(end(), std::move(val));
+    }
+    void pop_back() {
+        if (!empty()) {
+            erase(std::prev(end()));
+        }
+    }
+    T& back() {
+        chunk* c = static_cast<chunk*>(fake.left);
+        return c->data()[c->n - 1];
+    }
+    T const& back() const {
+        chunk* c = static_cast<chunk*>(fake.left);
+        return c->data()[c->n - 1];
+    }
+
+    void push_front(T const& val) {
+        emplace(begin(), val);
+    }
+    void push_front(T&& val) {
+        emplace(begin(), std::move(val));
+    }
+    void pop_front() {
+        if (!empty()) {
+            erase(begin());
+        }
+    }
+    T& front() {
+        return static_cast<chunk*>(fake.right)->data()[0];
+    }
+    T const& front() const {
+        return static_cast<chunk*>(fake.right)->data()[0];
+    }
+
+    iterator begin() {
+        return iterator(fake.right, 0);
+    }
+    const_iterator begin() const {
+        return const_iterator(fake.right, 0);
+    }
+
+    iterator end() {
+        return iterator(&fake, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(const_cast<node*>(static_cast<node const*>(&fake)), 0);
+    }
+
+    reverse_iterator rbegin() {
+        return reverse_iterator(end());
+    }
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() {
+        return reverse_iterator(begin());
+    }
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+    iterator insert(const_iterator pos, T const& val) {
+        return emplace(pos, val);
+    }
+    iterator insert(const_iterator pos, T&& val) {
+        return emplace(pos, std::move(val));
+    }
+    template <typename... Args>
+    iterator emplace(const_iterator pos, Args&&... args);
+    iterator erase(const_iterator pos);
+
+    void splice(const_iterator pos, unrolled_list& other, const_iterator first, const_iterator last);
+    void splice(const_iterator pos, unrolled_list& other);
+
+    void swap(unrolled_list& other);
+
+    friend void swap(unrolled_list& a, unrolled_list& b) {
+        a.swap(b);
+    }
+};
+
+template<typename T, size_t K, typename Alloc>
+unrolled_list<T, K, Alloc>::unrolled_list() = default;
+
+template<typename T, size_t K, typename Alloc>
+unrolled_list<T, K, Alloc>::unrolled_list(Alloc const& alloc) : fake(chunk_allocator(alloc)) {}
+
+template<typename T, size_t K, typename Alloc>
+unrolled_list<T, K, Alloc>::unrolled_list(unrolled_list const & other)
+    : unrolled_list(Alloc(chunk_traits::select_on_container_copy_construction(other.chunk_alloc()))) {
+    for(T const &v : other) {
+        push_back(v);
+    }
+}
+
+template<typename T, size_t K, typename Alloc>
+unrolled_list<T, K, Alloc>::unrolled_list(unrolled_list const & other, Alloc const& alloc) : unrolled_list(alloc) {
+    for(T const &v : other) {
+        push_back(v);
+    }
+}
+
+template<typename T, size_t K, typename Alloc>
+unrolled_list<T, K, Alloc>::unrolled_list(unrolled_list && other) noexcept : fake(other.chunk_alloc()) {
+    swap_nodes(other);
+}
+
+template<typename T, size_t K, typename Alloc>
+unrolled_list<T, K, Alloc>::~unrolled_list() {
+    clear();
+}
+
+template<typename T, size_t K, typename Alloc>
+unrolled_list<T, K, Alloc> &unrolled_list<T, K, Alloc>::operator=(unrolled_list const & other) {
+    if (this == &other) {
+        return *this;
+    }
+    constexpr bool propagate = chunk_traits::propagate_on_container_copy_assignment::value;
+    unrolled_list t(other, Alloc(propagate ? other.chunk_alloc() : chunk_alloc()));
+    clear();
+    if (propagate) {
+        chunk_alloc() = other.chunk_alloc();
+    }
+    swap_nodes(t);
+    return *this;
+}
+
+template<typename T, size_t K, typename Alloc>
+unrolled_list<T, K, Alloc> &unrolled_list<T, K, Alloc>::operator=(unrolled_list && other)
+        noexcept(chunk_traits::propagate_on_container_move_assignment::value
+                 || chunk_traits::is_always_equal::value) {
+    if (this == &other) {
+        return *this;
+    }
+    clear();
+    if (chunk_traits::propagate_on_container_move_assignment::value) {
+        chunk_alloc() = std::move(other.chunk_alloc());
+    } else if (chunk_alloc() != other.chunk_alloc()) {
+        for (T &v : other) {
+            push_back(std::move(v));
+        }
+        other.clear();
+        return *this;
+    }
+    swap_nodes(other);
+    return *this;
+}
+
+// Allocates an empty chunk and links it between left and right.
+template<typename T, size_t K, typename Alloc>
+typename unrolled_list<T, K, Alloc>::chunk* unrolled_list<T, K, Alloc>::create_chunk(node* left, node* right) {
+    chunk* c = chunk_traits::allocate(chunk_alloc(), 1);
+    new (c) chunk(left, right);
+    left->right = c;
+    right->left = c;
+    return c;
+}
+
+// Unlinks and frees a chunk whose elements are already destroyed.
+template<typename T, size_t K, typename Alloc>
+void unrolled_list<T, K, Alloc>::destroy_chunk(chunk* c) noexcept {
+    c->left->right = c->right;
+    c->right->left = c->left;
+    c->~chunk();
+    chunk_traits::deallocate(chunk_alloc(), c, 1);
+}
+
+// Moves elements [at, n) of c into a new chunk linked right after it.
+template<typename T, size_t K, typename Alloc>
+typename unrolled_list<T, K, Alloc>::chunk* unrolled_list<T, K, Alloc>::split(chunk* c, size_t at) {
+    chunk* half = create_chunk(c, c->right);
+    T* src = c->data();
+    T* dst = half->data();
+    try {
+        for (size_t i = at; i != c->n; ++i) {
+            new (dst + half->n) T(std::move_if_noexcept(src[i]));
+            ++half->n;
+        }
+    } catch (...) {
+        for (size_t i = 0; i != half->n; ++i) {
+            dst[i].~T();
+        }
+        destroy_chunk(half);
+        throw;
+    }
+    for (size_t i = at; i != c->n; ++i) {
+        src[i].~T();
+    }
+    c->n = at;
+    return half;
+}
+
+// Moves all elements of the chunk after c into c. The merge is only an
+// optimisation, so it is skipped (returning false) if relocating an element throws.
+template<typename T, size_t K, typename Alloc>
+bool unrolled_list<T, K, Alloc>::merge_next(chunk* c) noexcept {
+    chunk* next = static_cast<chunk*>(c->right);
+    assert(c->n + next->n <= K);
+    size_t old_n = c->n;
+    T* src = next->data();
+    T* dst = c->data();
+    try {
+        for (size_t i = 0; i != next->n; ++i) {
+            new (dst + c->n) T(std::move_if_noexcept(src[i]));
+            ++c->n;
+        }
+    } catch (...) {
+        for (size_t i = old_n; i != c->n; ++i) {
+            dst[i].~T();
+        }
+        c->n = old_n;
+        return false;
+    }
+    for (size_t i = 0; i != next->n; ++i) {
+        src[i].~T();
+    }
+    destroy_chunk(next);
+    return true;
+}
+
+// Places val at index i of a chunk that is not full, shifting the tail right.
+// The size is updated with the chunk's, so it stays right if a shift throws.
+template<typename T, size_t K, typename Alloc>
+void unrolled_list<T, K, Alloc>::insert_at(chunk* c, size_t i, T&& val) {
+    assert(c->n < K);
+    T* d = c->data();
+    size_t n = c->n;
+    if (i == n) {
+        new (d + n) T(std::move(val));
+        ++c->n;
+        ++count;
+    } else {
+        new (d + n) T(std::move(d[n - 1]));
+        ++c->n;
+        ++count;
+        for (size_t j = n - 1; j != i; --j) {
+            d[j] = std::move(d[j - 1]);
+        }
+        d[i] = std::move(val);
+    }
+}
+
+// Appending to a chunk moves no element, so the new one is constructed in place.
+// Otherwise making room moves elements the arguments may refer to, and the new
+// element is constructed first and then moved into its slot.
+template<typename T, size_t K, typename Alloc>
+template<typename... Args>
+typename unrolled_list<T, K, Alloc>::iterator unrolled_list<T, K, Alloc>::emplace(const_iterator pos, Args&&... args) {
+    chunk* c = static_cast<chunk*>(pos.cur);
+    size_t i = pos.idx;
+    if (pos.cur == &fake || (i == 0 && c->n == K)) {
+        // Inserting at a chunk boundary: append to the previous chunk or start a new one.
+        node* prev = pos.cur->left;
+        if (prev != &fake && static_cast<chunk*>(prev)->n < K) {
+            c = static_cast<chunk*>(prev);
+            i = c->n;
+        } else {
+            c = create_chunk(prev, pos.cur);
+            i = 0;
+        }
+    } else if (i != c->n || c->n == K) {
+        T val(std::forward<Args>(args)...);
+        if (c->n == K) {
+            chunk* half = split(c, K / 2);
+            if (i > K / 2) {
+                c = half;
+                i -= K / 2;
+            }
+        }
+        insert_at(c, i, std::move(val));
+        return iterator(c, i);
+    }
+
+    try {
+        new (c->data() + i) T(std::forward<Args>(args)...);
+    } catch (...) {
+        if (c->n == 0) {
+            destroy_chunk(c);
+        }
+        throw;
+    }
+    ++c->n;
+    ++count;
+    return iterator(c, i);
+}
+
+template<typename T, size_t K, typename Alloc>
+typename unrolled_list<T, K, Alloc>::iterator unrolled_list<T, K, Alloc>::erase(const_iterator pos) {
+    chunk* c = static_cast<chunk*>(pos.cur);
+    size_t i = pos.idx;
+    T* d = c->data();
+    for (size_t j = i; j + 1 < c->n; ++j) {
+        d[j] = std::move(d[j + 1]);
+    }
+    d[c->n - 1].~T();
+    --c->n;
+    --count;
+
+    if (c->n == 0) {
+        node* next = c->right;
+        destroy_chunk(c);
+        return iterator(next, 0);
+    }
+
+    // Keep chunks at least half full where possible by merging sparse neighbours.
+    chunk* next = static_cast<chunk*>(c->right);
+    chunk* prev = static_cast<chunk*>(c->left);
+    if (c->right != &fake && c->n + next->n <= K / 2) {
+        merge_next(c);
+    } else if (c->left != &fake && prev->n + c->n <= K / 2) {
+        size_t offset = prev->n;
+        if (merge_next(prev)) {
+            c = prev;
+            i += offset;
+        }
+    }
+    return i < c->n ? iterator(c, i) : iterator(c->right, 0);
+}
+
+template<typename T, size_t K, typename Alloc>
+void unrolled_list<T, K, Alloc>::clear() {
+    node* cur = fake.right;
+    while (cur != &fake) {
+        chunk* c = static_cast<chunk*>(cur);
+        cur = cur->right;
+        T* d = c->data();
+        for (size_t i = 0; i != c->n; ++i) {
+            d[i].~T();
+        }
+        c->~chunk();
+        chunk_traits::deallocate(chunk_alloc(), c, 1);
+    }
+    fake.right = fake.left = &fake;
+    count = 0;
+}
+
+template<typename T, size_t K, typename Alloc>
+void unrolled_list<T, K, Alloc>::splice(const_iterator pos, unrolled_list &other) {
+    splice(pos, other, other.begin(), other.end());
+}
+
+template<typename T, size_t K, typename Alloc>
+void unrolled_list<T, K, Alloc>::splice(const_iterator pos, unrolled_list &other, const_iterator first, const_iterator last) {
+    assert(&other == this || chunk_alloc() == other.chunk_alloc());
+    if (first == last) {
+        return;
+    }
+
+    // Split chunks so that first, last and pos all sit at chunk boundaries,
+    // moving any other iterator that pointed behind a split point.
+    const_iterator* its[] = {&first, &last, &pos};
+    auto cut = [&its](unrolled_list& owner, const_iterator& it) {
+        if (it.idx == 0) {
+            return;
+        }
+        chunk* c = static_cast<chunk*>(it.cur);
+        size_t at = it.idx;
+        chunk* half = owner.split(c, at);
+        for (const_iterator* other_it : its) {
+            if (other_it->cur == c && other_it->idx >= at) {
+                other_it->cur = half;
+                other_it->idx -= at;
+            }
+        }
+    };
+    cut(other, first);
+    cut(other, last);
+    cut(*this, pos);
+
+    if (&other != this) {
+        size_type n = 0;
+        for (node* c = first.cur; c != last.cur; c = c->right) {
+            n += static_cast<chunk*>(c)->n;
+        }
+        count += n;
+        other.count -= n;
+    }
+
+    node* l = first.cur->left;
+
+    pos.cur->left->right = first.cur;
+    first.cur->left = pos.cur->left;
+
+    last.cur->left->right = pos.cur;
+    pos.cur->left = last.cur->left;
+
+    last.cur->left = l;
+    l->right = last.cur;
+}
+
+template<typename T, size_t K, typename Alloc>
+void unrolled_list<T, K, Alloc>::swap_nodes(unrolled_list &other) noexcept {
+    node* a_l = fake.left;
+    node* a_r = fake.right;
+    node* b_l = other.fake.left;
+    node* b_r = other.fake.right;
+    a_l->right = &other.fake;
+    a_r->left = &other.fake;
+    b_l->right = &fake;
+    b_r->left = &fake;
+    std::swap(static_cast<node&>(fake), static_cast<node&>(other.fake));
+    std::swap(count, other.count);
+}
+
+template<typename T, size_t K, typename Alloc>
+void unrolled_list<T, K, Alloc>::swap(unrolled_list &other) {
+    if (chunk_traits::propagate_on_container_swap::value) {
+        using std::swap;
+        swap(chunk_alloc(), other.chunk_alloc());
+    } else {
+        assert(chunk_alloc() == other.chunk_alloc());
+    }
+    swap_nodes(other);
+}